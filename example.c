@@ -4,6 +4,7 @@
 #include <tstdio.h>
 #include <tstd.h>
 #include <tprintf.h>
+#include <ttable.h>
 
 static int conv_r(struct tpf_state *state, va_list *ap)
 {
@@ -24,6 +25,35 @@ static int conv_r(struct tpf_state *state, va_list *ap)
 	return 0;
 }
 
+static size_t write_stdout(void *arg, size_t len, const char *data)
+{
+	return fwrite(data, 1, len, stdout);
+}
+
+static const struct {
+	int pid;
+	const char *name;
+	unsigned long rss;
+} procs[] = {
+	{ 1, "init", 1204 }, { 417, "sshd", 5832 }, { 23051, "tprintf-example", 96 },
+};
+
+static int proc_row(struct tpf_row *row, size_t i, void *opaque)
+{
+	if (i == 0) {
+		tpf_cellf(row, "PID");
+		tpf_cellf(row, "COMMAND");
+		tpf_cellf(row, "RSS");
+		return 0;
+	}
+
+	i--;
+	tpf_cell(row, procs[i].pid);
+	tpf_cell(row, procs[i].name);
+	tpf_cell(row, procs[i].rss);
+	return 0;
+}
+
 int main(void)
 {
 	size_t n;
@@ -47,6 +77,13 @@ int main(void)
 	tprintf_printf("         1         2\n");
 	tprintf_printf("12345678901234567890\n");
 
+	{
+		struct tpf_column columns[] = { { "%d" }, { "%s", 1 }, { "%luK" } };
+		struct tpf_table table = { columns, 3, 4, "  ", proc_row };
+		struct tpf_output output = { write_stdout, 0 };
+		tpf_table(tprintf__context, &output, &table);
+	}
+
 	puts("invalid conversion");
 	tprintf_snprintf(0, 0, "%y");
 
@@ -0,0 +1,680 @@
+/* Generated by tool/specialize.py. */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <tprintf.h>
+#include <tstd.h>
+
+#include "_spec.h"
+
+/*
+ * The converters are called directly, so these only stand in for tvprintf()
+ * when the context has them registered, with the flags tstd.c gives them.
+ */
+static int spec_0(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "         1         2\n";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	tpf_write(&state, 21, "         1         2\n");
+
+	va_end(hack);
+	return state.pos;
+}
+
+static int spec_1(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "%*d";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+	int t;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	state.fpos = fmt + 0;
+	memcpy(state.flags, "", 1);
+	t = va_arg(hack, int);
+	if (t < 0) {
+		tpf_error(&state, "%d: field width cannot be negative", t);
+		goto fail;
+	}
+	state.fw = t;
+	state.fw_set = 1;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_i(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+
+	va_end(hack);
+	return state.pos;
+
+fail:
+	va_end(hack);
+	return -1;
+}
+
+static int spec_2(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "%-20s (%-5i|%5i)\n";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	state.fpos = fmt + 0;
+	memcpy(state.flags, "-", 2);
+	state.fw = 20;
+	state.fw_set = 1;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_s(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 2, " (");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 7;
+	memcpy(state.flags, "-", 2);
+	state.fw = 5;
+	state.fw_set = 1;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_i(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, "|");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 12;
+	memcpy(state.flags, "", 1);
+	state.fw = 5;
+	state.fw_set = 1;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_i(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 2, ")\n");
+
+done:
+	va_end(hack);
+	return state.pos;
+
+fail:
+	va_end(hack);
+	return -1;
+}
+
+static int spec_3(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "%-20s|%08.3u|%+d|%#o\n";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	state.fpos = fmt + 0;
+	memcpy(state.flags, "-", 2);
+	state.fw = 20;
+	state.fw_set = 1;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_s(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, "|");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 6;
+	memcpy(state.flags, "0", 2);
+	state.fw = 8;
+	state.fw_set = 1;
+	state.prec = 3;
+	state.prec_set = 1;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_u(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, "|");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 13;
+	memcpy(state.flags, "+", 2);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_i(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, "|");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 17;
+	memcpy(state.flags, "#", 2);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_o(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, "\n");
+
+done:
+	va_end(hack);
+	return state.pos;
+
+fail:
+	va_end(hack);
+	return -1;
+}
+
+static int spec_4(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "%c%c %5.2s %lld %llx\n";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	state.fpos = fmt + 0;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_c(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 2;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_c(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, " ");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 5;
+	memcpy(state.flags, "", 1);
+	state.fw = 5;
+	state.fw_set = 1;
+	state.prec = 2;
+	state.prec_set = 1;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_s(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, " ");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 11;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_ll;
+	if (tprintf__conv_i(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, " ");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 16;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_ll;
+	if (tprintf__conv_x(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, "\n");
+
+done:
+	va_end(hack);
+	return state.pos;
+
+fail:
+	va_end(hack);
+	return -1;
+}
+
+static int spec_5(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "%p is %zu characters long: \"%s\"\n";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	state.fpos = fmt + 0;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_p(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 4, " is ");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 6;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_z;
+	if (tprintf__conv_u(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 19, " characters long: \"");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 28;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_s(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 2, "\"\n");
+
+done:
+	va_end(hack);
+	return state.pos;
+
+fail:
+	va_end(hack);
+	return -1;
+}
+
+static int spec_6(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "%s[%d]: %u bytes from %x\n";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	state.fpos = fmt + 0;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_s(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, "[");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 3;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_i(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 3, "]: ");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 8;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_u(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 12, " bytes from ");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 22;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_x(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, "\n");
+
+done:
+	va_end(hack);
+	return state.pos;
+
+fail:
+	va_end(hack);
+	return -1;
+}
+
+static int spec_7(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "12345678901234567890\n";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	tpf_write(&state, 21, "12345678901234567890\n");
+
+	va_end(hack);
+	return state.pos;
+}
+
+static int spec_8(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "This is a long string that should be cut off at 31 characters.";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	tpf_write(&state, 62, "This is a long string that should be cut off at 31 characters.");
+
+	va_end(hack);
+	return state.pos;
+}
+
+static int spec_9(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "integers/tprintf: %010.5d\n";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	tpf_write(&state, 18, "integers/tprintf: ");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 18;
+	memcpy(state.flags, "0", 2);
+	state.fw = 10;
+	state.fw_set = 1;
+	state.prec = 5;
+	state.prec_set = 1;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_i(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, "\n");
+
+done:
+	va_end(hack);
+	return state.pos;
+
+fail:
+	va_end(hack);
+	return -1;
+}
+
+static int spec_10(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "octal constants: %o %#o\n";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	tpf_write(&state, 17, "octal constants: ");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 17;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_o(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, " ");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 20;
+	memcpy(state.flags, "#", 2);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_o(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 1, "\n");
+
+done:
+	va_end(hack);
+	return state.pos;
+
+fail:
+	va_end(hack);
+	return -1;
+}
+
+static int spec_11(const struct tpf_context *context, const struct tpf_output *output, va_list ap)
+{
+	static const char fmt[] = "{\"msg\":%#J,\"n\":%zu}\n";
+	struct tpf_state state = {.context = context};
+	va_list hack;
+
+	state.format = fmt;
+	state.output = output;
+	va_copy(hack, ap);
+
+	tpf_write(&state, 7, "{\"msg\":");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 7;
+	memcpy(state.flags, "#", 2);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_UNSET;
+	if (tprintf__conv_J(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 5, ",\"n\":");
+	if (state.error)
+		goto done;
+
+	state.fpos = fmt + 15;
+	memcpy(state.flags, "", 1);
+	state.fw_set = 0;
+	state.prec_set = 0;
+	state.length = LENGTH_z;
+	if (tprintf__conv_u(&state, &hack) != 0)
+		goto fail;
+	tpf_repeat(&state, ' ', state.padding);
+	state.padding = 0;
+	if (state.error)
+		goto done;
+
+	tpf_write(&state, 2, "}\n");
+
+done:
+	va_end(hack);
+	return state.pos;
+
+fail:
+	va_end(hack);
+	return -1;
+}
+
+static const struct tpf_special specials[] = {
+	{ "         1         2\n", spec_0 },
+	{ "%*d", spec_1 },
+	{ "%-20s (%-5i|%5i)\n", spec_2 },
+	{ "%-20s|%08.3u|%+d|%#o\n", spec_3 },
+	{ "%c%c %5.2s %lld %llx\n", spec_4 },
+	{ "%p is %zu characters long: \"%s\"\n", spec_5 },
+	{ "%s[%d]: %u bytes from %x\n", spec_6 },
+	{ "12345678901234567890\n", spec_7 },
+	{ "This is a long string that should be cut off at 31 characters.", spec_8 },
+	{ "integers/tprintf: %010.5d\n", spec_9 },
+	{ "octal constants: %o %#o\n", spec_10 },
+	{ "{\"msg\":%#J,\"n\":%zu}\n", spec_11 },
+};
+
+int tprintf__specialize(struct tpf_context *context)
+{
+	static const struct {
+		char spec;
+		const char *flags;
+		int (*callback)(struct tpf_state *, va_list *);
+	} uses[] = {
+		{ 'J', "#-", tprintf__conv_J },
+		{ 'c', " +-", tprintf__conv_c },
+		{ 'd', " +-0", tprintf__conv_i },
+		{ 'i', " +-0", tprintf__conv_i },
+		{ 'o', " #+-0", tprintf__conv_o },
+		{ 'p', " +-", tprintf__conv_p },
+		{ 's', " +-", tprintf__conv_s },
+		{ 'u', " +-0", tprintf__conv_u },
+		{ 'x', " #+-0", tprintf__conv_x },
+		{ 0 }
+	};
+	size_t i;
+
+	for (i = 0; uses[i].spec; i++) {
+		const struct tpf_format *f = context->fmts[(unsigned char) uses[i].spec];
+		if (!f || f->callback != uses[i].callback || strcmp(f->flags, uses[i].flags) != 0)
+			return -1;
+	}
+
+	tpf_specialize(context, specials, sizeof specials / sizeof *specials);
+	return 0;
+}
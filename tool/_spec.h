@@ -0,0 +1,15 @@
+/* Generated by tool/specialize.py. */
+
+#ifndef _SPEC_H
+#define _SPEC_H
+
+#include <tprintf.h>
+
+/*
+ * Makes tvprintf() with context use the compiled formats. Returns -1, and
+ * leaves the context as it was, unless every conversion they use is the one
+ * tprintf__init() registers; that must stay so for as long as they are used.
+ */
+int tprintf__specialize(struct tpf_context *);
+
+#endif
@@ -0,0 +1,141 @@
+/* Generated by tool/specialize.py. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+
+#include <tprintf.h>
+#include <tstd.h>
+#include <tstdio.h>
+
+int tprintf__specialize(struct tpf_context *);
+
+struct sink {
+	char buf[4096];
+	size_t len;
+};
+
+static size_t write_sink(void *arg, size_t len, const char *data)
+{
+	struct sink *sink = arg;
+
+	if (len > sizeof sink->buf - sink->len)
+		len = sizeof sink->buf - sink->len;
+	memcpy(sink->buf + sink->len, data, len);
+	sink->len += len;
+	return len;
+}
+
+static struct tpf_context special, plain;
+static struct sink a, b;
+
+static int run(const struct tpf_context *context, struct sink *sink, const char *fmt, ...)
+{
+	struct tpf_output out = { write_sink, sink };
+	va_list ap;
+	int r;
+
+	sink->len = 0;
+	va_start(ap, fmt);
+	r = tvprintf(context, &out, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+/* The test calls pass the literal from the source, so this finds misparsed ones. */
+static int compiled(const char *fmt)
+{
+	struct tpf_output out = tpf_output_FILE(stdout);
+	size_t i;
+
+	for (i = 0; i < special.nspecial; i++)
+		if (strcmp(special.special[i].format, fmt) == 0)
+			return 1;
+
+	tprintf(tprintf__context, &out, "XXX %#q: not among the compiled formats\n", fmt);
+	return 0;
+}
+
+static int same(const char *fmt, int r1, int r2)
+{
+	struct tpf_output out = tpf_output_FILE(stdout);
+
+	if (r1 == r2 && a.len == b.len && memcmp(a.buf, b.buf, a.len) == 0)
+		return 1;
+
+	tprintf(tprintf__context, &out, "XXX %#q: compiled gave %d, %#.*q; tvprintf gave %d, %#.*q\n",
+	        fmt, r1, (int) a.len, a.buf, r2, (int) b.len, b.buf);
+	return 0;
+}
+
+int main(void)
+{
+	int tests = 0, passed = 0;
+	size_t i;
+
+	tprintf__init();
+	special = *tprintf__context;
+	plain = *tprintf__context;
+	if (tprintf__specialize(&special) != 0) {
+		printf("XXX the context does not take the compiled formats\n");
+		return 1;
+	}
+
+	for (i = 1; i < special.nspecial; i++) {
+		if (strcmp(special.special[i - 1].format, special.special[i].format) >= 0) {
+			printf("XXX specializations are out of order at %zu\n", i);
+			return 1;
+		}
+	}
+
+	tests++;
+	passed += compiled("         1         2\n") && same("         1         2\n", run(&special, &a, "         1         2\n"), run(&plain, &b, "         1         2\n"));
+	tests++;
+	passed += compiled("%*d") && same("%*d", run(&special, &a, "%*d", 7, (int) -42), run(&plain, &b, "%*d", 7, (int) -42));
+	tests++;
+	passed += compiled("%*d") && same("%*d", run(&special, &a, "%*d", 0, (int) 1234567), run(&plain, &b, "%*d", 0, (int) 1234567));
+	tests++;
+	passed += compiled("%-20s (%-5i|%5i)\n") && same("%-20s (%-5i|%5i)\n", run(&special, &a, "%-20s (%-5i|%5i)\n", "sample", (int) -42, (int) -42), run(&plain, &b, "%-20s (%-5i|%5i)\n", "sample", (int) -42, (int) -42));
+	tests++;
+	passed += compiled("%-20s (%-5i|%5i)\n") && same("%-20s (%-5i|%5i)\n", run(&special, &a, "%-20s (%-5i|%5i)\n", (const char *) NULL, (int) 1234567, (int) 1234567), run(&plain, &b, "%-20s (%-5i|%5i)\n", (const char *) NULL, (int) 1234567, (int) 1234567));
+	tests++;
+	passed += compiled("%-20s|%08.3u|%+d|%#o\n") && same("%-20s|%08.3u|%+d|%#o\n", run(&special, &a, "%-20s|%08.3u|%+d|%#o\n", "sample", (unsigned) 0, (int) -42, (unsigned) 0), run(&plain, &b, "%-20s|%08.3u|%+d|%#o\n", "sample", (unsigned) 0, (int) -42, (unsigned) 0));
+	tests++;
+	passed += compiled("%-20s|%08.3u|%+d|%#o\n") && same("%-20s|%08.3u|%+d|%#o\n", run(&special, &a, "%-20s|%08.3u|%+d|%#o\n", (const char *) NULL, (unsigned) 3054, (int) 1234567, (unsigned) 3054), run(&plain, &b, "%-20s|%08.3u|%+d|%#o\n", (const char *) NULL, (unsigned) 3054, (int) 1234567, (unsigned) 3054));
+	tests++;
+	passed += compiled("%c%c %5.2s %lld %llx\n") && same("%c%c %5.2s %lld %llx\n", run(&special, &a, "%c%c %5.2s %lld %llx\n", 'q', 'q', "sample", (long long) -42, (unsigned long long) 0), run(&plain, &b, "%c%c %5.2s %lld %llx\n", 'q', 'q', "sample", (long long) -42, (unsigned long long) 0));
+	tests++;
+	passed += compiled("%c%c %5.2s %lld %llx\n") && same("%c%c %5.2s %lld %llx\n", run(&special, &a, "%c%c %5.2s %lld %llx\n", '!', '!', (const char *) NULL, (long long) 1234567, (unsigned long long) 3054), run(&plain, &b, "%c%c %5.2s %lld %llx\n", '!', '!', (const char *) NULL, (long long) 1234567, (unsigned long long) 3054));
+	tests++;
+	passed += compiled("%p is %zu characters long: \"%s\"\n") && same("%p is %zu characters long: \"%s\"\n", run(&special, &a, "%p is %zu characters long: \"%s\"\n", (void *) 0x1234, (size_t) 0, "sample"), run(&plain, &b, "%p is %zu characters long: \"%s\"\n", (void *) 0x1234, (size_t) 0, "sample"));
+	tests++;
+	passed += compiled("%p is %zu characters long: \"%s\"\n") && same("%p is %zu characters long: \"%s\"\n", run(&special, &a, "%p is %zu characters long: \"%s\"\n", (void *) NULL, (size_t) 3054, (const char *) NULL), run(&plain, &b, "%p is %zu characters long: \"%s\"\n", (void *) NULL, (size_t) 3054, (const char *) NULL));
+	tests++;
+	passed += compiled("%s[%d]: %u bytes from %x\n") && same("%s[%d]: %u bytes from %x\n", run(&special, &a, "%s[%d]: %u bytes from %x\n", "sample", (int) -42, (unsigned) 0, (unsigned) 0), run(&plain, &b, "%s[%d]: %u bytes from %x\n", "sample", (int) -42, (unsigned) 0, (unsigned) 0));
+	tests++;
+	passed += compiled("%s[%d]: %u bytes from %x\n") && same("%s[%d]: %u bytes from %x\n", run(&special, &a, "%s[%d]: %u bytes from %x\n", (const char *) NULL, (int) 1234567, (unsigned) 3054, (unsigned) 3054), run(&plain, &b, "%s[%d]: %u bytes from %x\n", (const char *) NULL, (int) 1234567, (unsigned) 3054, (unsigned) 3054));
+	tests++;
+	passed += compiled("12345678901234567890\n") && same("12345678901234567890\n", run(&special, &a, "12345678901234567890\n"), run(&plain, &b, "12345678901234567890\n"));
+	tests++;
+	passed += compiled("This is a long string that should be cut off at 31 characters.") && same("This is a long string that should be cut off at 31 characters.", run(&special, &a, "This is a long string that should be cut off at 31 characters."), run(&plain, &b, "This is a long string that should be cut off at 31 characters."));
+	tests++;
+	passed += compiled("integers/tprintf: %010.5d\n") && same("integers/tprintf: %010.5d\n", run(&special, &a, "integers/tprintf: %010.5d\n", (int) -42), run(&plain, &b, "integers/tprintf: %010.5d\n", (int) -42));
+	tests++;
+	passed += compiled("integers/tprintf: %010.5d\n") && same("integers/tprintf: %010.5d\n", run(&special, &a, "integers/tprintf: %010.5d\n", (int) 1234567), run(&plain, &b, "integers/tprintf: %010.5d\n", (int) 1234567));
+	tests++;
+	passed += compiled("octal constants: %o %#o\n") && same("octal constants: %o %#o\n", run(&special, &a, "octal constants: %o %#o\n", (unsigned) 0, (unsigned) 0), run(&plain, &b, "octal constants: %o %#o\n", (unsigned) 0, (unsigned) 0));
+	tests++;
+	passed += compiled("octal constants: %o %#o\n") && same("octal constants: %o %#o\n", run(&special, &a, "octal constants: %o %#o\n", (unsigned) 3054, (unsigned) 3054), run(&plain, &b, "octal constants: %o %#o\n", (unsigned) 3054, (unsigned) 3054));
+	tests++;
+	passed += compiled("{\"msg\":%#J,\"n\":%zu}\n") && same("{\"msg\":%#J,\"n\":%zu}\n", run(&special, &a, "{\"msg\":%#J,\"n\":%zu}\n", "a \"b\",c\n", (size_t) 0), run(&plain, &b, "{\"msg\":%#J,\"n\":%zu}\n", "a \"b\",c\n", (size_t) 0));
+	tests++;
+	passed += compiled("{\"msg\":%#J,\"n\":%zu}\n") && same("{\"msg\":%#J,\"n\":%zu}\n", run(&special, &a, "{\"msg\":%#J,\"n\":%zu}\n", "plain", (size_t) 3054), run(&plain, &b, "{\"msg\":%#J,\"n\":%zu}\n", "plain", (size_t) 3054));
+
+	printf("%d tests, %d passed\n", tests, passed);
+	return passed != tests;
+}
@@ -0,0 +1,273 @@
+/*
+ * Measure how tprintf scales with the number of threads calling it at once.
+ *
+ *   bench [-t max threads] [-n calls per thread]
+ *
+ * Each thread count (powers of two up to the maximum) is run against three
+ * sinks: a buffer per thread, one stdio FILE shared by every thread, and a
+ * file descriptor. All of them end up in /dev/null.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tprintf.h>
+#include <tstd.h>
+#include <tstdio.h>
+#include <ttable.h>
+
+enum sink { SINK_BUFFER, SINK_FILE, SINK_FD, SINKS };
+
+static const char *sink_names[] = { "buffer", "FILE", "fd" };
+
+struct result {
+	enum sink sink;
+	int threads;
+	uint64_t calls_per_sec;
+	uint32_t p50, p99, p999;
+	unsigned efficiency;
+};
+
+struct worker {
+	pthread_t thread;
+	enum sink sink;
+	size_t calls;
+	uint32_t *latency;
+	struct timespec start, end;
+};
+
+static pthread_barrier_t barrier;
+static FILE *shared_file;
+static int shared_fd;
+
+static size_t write_fd(void *arg, size_t len, const char *data)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = write(*(int *) arg, data + done, len - done);
+		if (r <= 0)
+			break;
+		done += r;
+	}
+
+	return done;
+}
+
+static uint64_t ns(const struct timespec *ts)
+{
+	return (uint64_t) ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+/* A mix of what log lines tend to look like. */
+static int call(const struct tpf_output *out, size_t i)
+{
+	static const char *names[] = { "worker", "a rather longer connection name", "" };
+
+	switch (i % 4) {
+	case 0:
+		return tprintf(tprintf__context, out, "%s[%d]: %u bytes from %x\n", names[i % 3], (int) i, (unsigned) i * 7, (unsigned) i);
+	case 1:
+		return tprintf(tprintf__context, out, "%-20s|%08.3u|%+d|%#o\n", names[i % 3], (unsigned) i, -(int) i, (unsigned) i);
+	case 2:
+		return tprintf(tprintf__context, out, "{\"msg\":%#J,\"n\":%zu}\n", names[i % 3], i);
+	default:
+		return tprintf(tprintf__context, out, "%c%c %5.2s %lld %llx\n", 'o', 'k', "abc", (long long) i << 20, (long long) i);
+	}
+}
+
+static void *run(void *arg)
+{
+	struct worker *w = arg;
+	struct timespec a, b;
+	char buf[256];
+	struct tpf_buffer buffer;
+	struct tpf_output out;
+	size_t i;
+
+	switch (w->sink) {
+	case SINK_BUFFER: out = tpf_output_buffer(&buffer);                    break;
+	case SINK_FILE:   out = tpf_output_FILE(shared_file);                  break;
+	default:          out = (struct tpf_output) { write_fd, &shared_fd };  break;
+	}
+
+	pthread_barrier_wait(&barrier);
+	clock_gettime(CLOCK_MONOTONIC, &w->start);
+
+	for (i = 0; i < w->calls; i++) {
+		buffer.output = buf;
+		buffer.pos = 0;
+		buffer.limit = sizeof buf;
+
+		clock_gettime(CLOCK_MONOTONIC, &a);
+		call(&out, i);
+		clock_gettime(CLOCK_MONOTONIC, &b);
+
+		w->latency[i] = ns(&b) - ns(&a) > UINT32_MAX ? UINT32_MAX : ns(&b) - ns(&a);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &w->end);
+	return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t a_ = *(const uint32_t *) a, b_ = *(const uint32_t *) b;
+	return (a_ > b_) - (a_ < b_);
+}
+
+static void measure(struct result *r, enum sink sink, int threads, size_t calls)
+{
+	struct worker *w = calloc(threads, sizeof *w);
+	uint32_t *latency = malloc(sizeof *latency * calls * threads);
+	uint64_t start = UINT64_MAX, end = 0, total = (uint64_t) calls * threads;
+	int i;
+
+	if (!w || !latency) {
+		perror("bench");
+		exit(1);
+	}
+
+	pthread_barrier_init(&barrier, NULL, threads);
+
+	for (i = 0; i < threads; i++) {
+		w[i].sink = sink;
+		w[i].calls = calls;
+		w[i].latency = latency + calls * i;
+		errno = pthread_create(&w[i].thread, NULL, run, &w[i]);
+		if (errno) {
+			/* the others would wait at the barrier forever */
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(w[i].thread, NULL);
+		if (ns(&w[i].start) < start) start = ns(&w[i].start);
+		if (ns(&w[i].end)   > end)   end   = ns(&w[i].end);
+	}
+
+	pthread_barrier_destroy(&barrier);
+
+	qsort(latency, total, sizeof *latency, cmp_u32);
+
+	r->sink = sink;
+	r->threads = threads;
+	r->calls_per_sec = end > start ? total * 1000000000 / (end - start) : 0;
+	r->p50  = latency[total * 500 / 1000];
+	r->p99  = latency[total * 990 / 1000];
+	r->p999 = latency[total * 999 / 1000];
+
+	free(latency);
+	free(w);
+}
+
+static int result_row(struct tpf_row *row, size_t i, void *opaque)
+{
+	const struct result *r = opaque;
+
+	if (i == 0) {
+		tpf_cellf(row, "sink");
+		tpf_cellf(row, "threads");
+		tpf_cellf(row, "calls/s");
+		tpf_cellf(row, "p50 ns");
+		tpf_cellf(row, "p99 ns");
+		tpf_cellf(row, "p999 ns");
+		tpf_cellf(row, "scaling");
+		return 0;
+	}
+
+	r += i - 1;
+	tpf_cell(row, sink_names[r->sink]);
+	tpf_cell(row, r->threads);
+	tpf_cell(row, (unsigned long long) r->calls_per_sec);
+	tpf_cell(row, (unsigned) r->p50);
+	tpf_cell(row, (unsigned) r->p99);
+	tpf_cell(row, (unsigned) r->p999);
+	tpf_cell(row, r->efficiency);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct tpf_column columns[] = {
+		{ "%s", 1 }, { "%d" }, { "%llu" }, { "%u" }, { "%u" }, { "%u" }, { "%u%%" }
+	};
+	struct tpf_table table = { columns, 7, 0, "  ", result_row };
+	struct tpf_output out = tpf_output_FILE(stdout);
+	struct result *results;
+	long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t calls = 100000, n = 0;
+	int c, t, counts = 0;
+	enum sink sink;
+
+	while ((c = getopt(argc, argv, "t:n:")) != -1) {
+		switch (c) {
+		case 't': max_threads = atol(optarg); break;
+		case 'n': calls = strtoul(optarg, NULL, 10); break;
+		default:
+			fprintf(stderr, "usage: %s [-t max threads] [-n calls per thread]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (max_threads < 1)
+		max_threads = 1;
+	if (calls < 1)
+		calls = 1;
+
+	tprintf__init();
+
+	shared_file = fopen("/dev/null", "w");
+	shared_fd = open("/dev/null", O_WRONLY);
+	if (!shared_file || shared_fd < 0) {
+		perror("/dev/null");
+		return 1;
+	}
+
+	for (t = 1; t < max_threads; t *= 2)
+		counts++;
+	counts++;
+
+	results = calloc(SINKS * counts, sizeof *results);
+	if (!results) {
+		perror("bench");
+		return 1;
+	}
+
+	for (sink = 0; sink < SINKS; sink++) {
+		uint64_t single = 0;
+
+		for (t = 1; ; t = t * 2 < max_threads ? t * 2 : max_threads) {
+			struct result *r = &results[n++];
+
+			measure(r, sink, t, calls);
+			if (t == 1)
+				single = r->calls_per_sec;
+			r->efficiency = single ? r->calls_per_sec * 100 / (single * t) : 0;
+
+			if (t == max_threads)
+				break;
+		}
+	}
+
+	table.nrows = n + 1;
+	table.opaque = results;
+	tpf_table(tprintf__context, &out, &table);
+
+	free(results);
+	fclose(shared_file);
+	close(shared_fd);
+	return 0;
+}
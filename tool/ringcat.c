@@ -0,0 +1,68 @@
+/*
+ * Drain a tprintf ring to stdout.
+ *
+ *   ringcat [-f] [-r] file
+ *
+ * -f keeps following the ring for new records; -r skips records whose writer
+ * went away before finishing them, as after a crash. The two don't go together:
+ * -r is only safe once nothing is writing to the ring.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tprintf.h>
+#include <tring.h>
+#include <tstdio.h>
+
+int main(int argc, char **argv)
+{
+	struct timespec delay = { 0, 100000000 };
+	struct tpf_output out = tpf_output_FILE(stdout);
+	struct tpf_ring ring;
+	int follow = 0, recover = 0, c;
+
+	while ((c = getopt(argc, argv, "fr")) != -1) {
+		switch (c) {
+		case 'f': follow  = 1; break;
+		case 'r': recover = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-f] [-r] file\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (follow && recover) {
+		fprintf(stderr, "%s: -r needs the ring's writers gone, so it can't be used with -f\n", argv[0]);
+		return 2;
+	}
+
+	if (optind != argc - 1) {
+		fprintf(stderr, "usage: %s [-f] [-r] file\n", argv[0]);
+		return 2;
+	}
+
+	if (tpf_ring_open(&ring, argv[optind], 0) != 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	do {
+		if (tpf_ring_drain(&ring, &out, recover) > 0)
+			fflush(stdout);
+		else if (follow)
+			nanosleep(&delay, NULL);
+	} while (follow);
+
+	if (tpf_ring_dropped(&ring) || tpf_ring_truncated(&ring))
+		fprintf(stderr, "%s: %llu records dropped, %llu truncated\n", argv[optind],
+		        (unsigned long long) tpf_ring_dropped(&ring),
+		        (unsigned long long) tpf_ring_truncated(&ring));
+
+	tpf_ring_close(&ring);
+	return 0;
+}
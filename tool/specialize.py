@@ -0,0 +1,666 @@
+"""
+Compile the literal formats passed to tprintf in some C sources ahead of time.
+
+    specialize.py OUT SOURCE...
+
+Writes OUT.c, with a function per format that does what tvprintf() would
+without parsing it, and tprintf__specialize() to hand them to a context; OUT.h,
+which declares that; and OUT_test.c, which checks every one of them against
+tvprintf() parsing the same format.
+
+Only formats using the conversions from tstd.c, in ways that are valid, are
+compiled. Anything else is left to tvprintf().
+"""
+
+import os.path
+import re
+import sys
+
+# Calls whose format is a literal, and which argument it is.
+CALLS = {
+    'tprintf':          2,
+    'tprintf_printf':   0,
+    'tprintf_sprintf':  1,
+    'tprintf_snprintf': 2,
+    'tprintf_slprintf': 2,
+}
+
+SIGNED   = (None, 'hh', 'h', 'l', 'll', 'j', 't', 'w128')
+UNSIGNED = (None, 'hh', 'h', 'l', 'll', 'j', 'z', 'w128')
+
+# conversion: (flags, valid length modifiers), as tstd.c registers them
+CONVERSIONS = {
+    '%': ('',      (None,)),
+    'c': (' +-',   (None, 'l')),
+    'd': (' +-0',  SIGNED),
+    'i': (' +-0',  SIGNED),
+    'n': ('',      (None,)),
+    'o': (' +-0#', UNSIGNED),
+    'p': (' +-',   (None,)),
+    's': (' +-',   (None, 'l')),
+    'V': (' +-',   (None, 'l')),
+    'u': (' +-0',  UNSIGNED),
+    'x': (' +-0#', UNSIGNED),
+    'X': (' +-0#', UNSIGNED),
+    'D': (' +-#',  (None,)),
+    'T': ('-#',    (None,)),
+    'J': ('-#',    (None,)),
+    'Q': ('-#',    (None,)),
+    'q': ('-#',    (None,)),
+    'v': (' +-0#', SIGNED + ('z',)),
+}
+
+# The converter tstd.c registers for each conversion, which compiled formats
+# call directly.
+CONVERTERS = {
+    '%': 'tprintf__conv_pct', 'd': 'tprintf__conv_i', 'i': 'tprintf__conv_i',
+}
+
+def converter(spec):
+    return CONVERTERS.get(spec, 'tprintf__conv_' + spec)
+
+# The elements %v takes, which work out their flags and lengths as the
+# conversions themselves do.
+ELEMENTS = 'diuoxX'
+
+# Too large for any field width to be worth compiling.
+WIDTH_MAX = 2 ** 31 - 1
+
+ESCAPES = {
+    'n': 10, 't': 9, 'r': 13, 'a': 7, 'b': 8, 'f': 12, 'v': 11,
+    '\\': 92, '"': 34, "'": 39, '?': 63,
+}
+
+class Conversion:
+    def __init__(self, offset, flags, width, prec, length, spec, conv, elem):
+        self.offset = offset
+        self.flags = flags
+        self.width = width
+        self.prec = prec
+        self.length = length
+        self.spec = spec
+        self.conv = conv
+        self.elem = elem
+
+def skip_literal(src, i):
+    """Returns the index past the string or character literal at i."""
+    q = src[i]
+    i += 1
+    while i < len(src) and src[i] != q:
+        i += 2 if src[i] == '\\' else 1
+    return i + 1
+
+def strip_comments(src):
+    out = []
+    i = 0
+    while i < len(src):
+        if src.startswith('/*', i):
+            j = src.find('*/', i + 2)
+            i = len(src) if j < 0 else j + 2
+            out.append(' ')
+        elif src.startswith('//', i):
+            j = src.find('\n', i)
+            i = len(src) if j < 0 else j
+        elif src[i] in '"\'':
+            j = skip_literal(src, i)
+            out.append(src[i:j])
+            i = j
+        else:
+            out.append(src[i])
+            i += 1
+    return ''.join(out)
+
+def split_args(src, i):
+    """Splits the arguments of the call whose '(' is at i."""
+    args = []
+    depth = 0
+    start = i + 1
+    i += 1
+    while i < len(src):
+        c = src[i]
+        if c in '"\'':
+            i = skip_literal(src, i)
+            continue
+        if c in '([{':
+            depth += 1
+        elif c in ')]}':
+            if depth == 0:
+                args.append(src[start:i])
+                return args
+            depth -= 1
+        elif c == ',' and depth == 0:
+            args.append(src[start:i])
+            start = i + 1
+        i += 1
+    return None
+
+def parse_string(arg):
+    """The bytes of an argument made only of string literals, or None."""
+    arg = arg.strip()
+    out = bytearray()
+    if not arg.startswith('"'):
+        return None
+    while arg:
+        if not arg.startswith('"'):
+            return None
+        end = skip_literal(arg, 0)
+        body = arg[1:end - 1]
+        i = 0
+        while i < len(body):
+            c = body[i]
+            if c != '\\':
+                out += c.encode('latin-1')
+                i += 1
+                continue
+            i += 1
+            c = body[i]
+            if c in ESCAPES:
+                out.append(ESCAPES[c])
+                i += 1
+            elif c in '01234567':
+                m = re.match('[0-7]{1,3}', body[i:])
+                out.append(int(m.group(), 8) & 0xff)
+                i += len(m.group())
+            elif c == 'x':
+                m = re.match('[0-9a-fA-F]+', body[i + 1:])
+                if not m:
+                    return None
+                out.append(int(m.group(), 16) & 0xff)
+                i += 1 + len(m.group())
+            else:
+                return None
+        arg = arg[end:].lstrip()
+    return bytes(out)
+
+def scan(path):
+    with open(path, encoding='latin-1') as f:
+        src = strip_comments(f.read())
+    for m in re.finditer(r'(?<![\w.>])(' + '|'.join(CALLS) + r')\s*\(', src):
+        args = split_args(src, m.end() - 1)
+        if args is None or len(args) <= CALLS[m.group(1)]:
+            continue
+        arg = args[CALLS[m.group(1)]].strip()
+        # what a trigraph means depends on how the source is compiled
+        if re.search(r"\?\?[=/'()!<>-]", arg):
+            continue
+        fmt = parse_string(arg)
+        if fmt is not None and b'\0' not in fmt:
+            yield fmt, arg
+
+def isalnum(c):
+    return c < 128 and chr(c).isalnum()
+
+def read_number(fmt, i):
+    m = re.match(rb'[0-9]+', fmt[i:])
+    if not m:
+        return None, i
+    return int(m.group()), i + len(m.group())
+
+def parse(fmt):
+    """
+    Splits a format into literal runs and conversions, just as tvprintf() would,
+    or returns None if it is not one worth compiling.
+    """
+    steps = []
+    lit = bytearray()
+    i = 0
+    while i < len(fmt):
+        if fmt[i] != ord('%'):
+            lit.append(fmt[i])
+            i += 1
+            continue
+
+        if lit:
+            steps.append(bytes(lit))
+            lit = bytearray()
+        offset = i
+        i += 1
+
+        q = i
+        while q < len(fmt) and not (isalnum(fmt[q]) and fmt[q] != ord('0') or fmt[q] in b'.%*'):
+            q += 1
+        flags = fmt[i:q]
+        i = q
+        if len(flags) > 15:
+            return None
+
+        width = None
+        if fmt[i:i + 1] == b'*':
+            width = '*'
+            i += 1
+        else:
+            width, i = read_number(fmt, i)
+            if width is not None and width > WIDTH_MAX:
+                return None
+
+        prec = None
+        if fmt[i:i + 1] == b'.':
+            i += 1
+            if fmt[i:i + 1] == b'*':
+                prec = '*'
+                i += 1
+            elif fmt[i:i + 1] in (b' ', b'\t', b'\n', b'\v', b'\f', b'\r', b'+', b'-'):
+                return None
+            else:
+                prec, i = read_number(fmt, i)
+                if prec is None:
+                    prec = 0
+                elif prec > WIDTH_MAX:
+                    return None
+
+        length = None
+        for l in ('hh', 'h', 'll', 'l', 'j', 'z', 't', 'L', 'w128'):
+            if fmt[i:].startswith(l.encode()):
+                length = l
+                i += len(l)
+                break
+
+        if i >= len(fmt):
+            return None
+        conv = i
+        spec = chr(fmt[i])
+        i += 1
+
+        elem = None
+        if spec == 'v':
+            if i >= len(fmt) or chr(fmt[i]) not in ELEMENTS:
+                return None
+            elem = chr(fmt[i])
+            i += 1
+
+        if spec not in CONVERSIONS:
+            return None
+        allow, lengths = CONVERSIONS[elem or spec]
+        if any(chr(f) not in allow for f in flags) or length not in lengths:
+            return None
+
+        steps.append(Conversion(offset, bytes(sorted(flags)), width, prec, length, spec, conv, elem))
+
+    if lit:
+        steps.append(bytes(lit))
+    return steps
+
+def c_string(b):
+    out = ['"']
+    prev = None
+    for c in b:
+        ch = chr(c)
+        if ch in '\\"':
+            out.append('\\' + ch)
+        elif ch == '\n':
+            out.append('\\n')
+        elif ch == '\t':
+            out.append('\\t')
+        elif ch == '?' and prev == ord('?'):
+            out.append('\\?')
+        elif 32 <= c < 127:
+            out.append(ch)
+        else:
+            # always three digits, so that a digit after it isn't read as part of it
+            out.append('\\%03o' % c)
+        prev = c
+    out.append('"')
+    return ''.join(out)
+
+def c_char(c):
+    return "'\\''" if c == "'" else "'\\\\'" if c == '\\' else "'%s'" % c
+
+def gen_function(name, fmt, steps):
+    convs = [s for s in steps if isinstance(s, Conversion)]
+    star = any(c.width == '*' or c.prec == '*' for c in convs)
+    body = []
+    stops = False
+
+    for n, step in enumerate(steps):
+        if n > 0:
+            body.append('\tif (state.error)')
+            body.append('\t\tgoto done;')
+            body.append('')
+            stops = True
+
+        if not isinstance(step, Conversion):
+            body.append('\ttpf_write(&state, %d, %s);' % (len(step), c_string(step)))
+            continue
+
+        body.append('\tstate.fpos = fmt + %d;' % step.offset)
+        body.append('\tmemcpy(state.flags, %s, %d);' % (c_string(step.flags), len(step.flags) + 1))
+        if step.width == '*':
+            body.append('\tt = va_arg(hack, int);')
+            body.append('\tif (t < 0) {')
+            body.append('\t\ttpf_error(&state, "%d: field width cannot be negative", t);')
+            body.append('\t\tgoto fail;')
+            body.append('\t}')
+            body.append('\tstate.fw = t;')
+            body.append('\tstate.fw_set = 1;')
+        elif step.width is not None:
+            body.append('\tstate.fw = %d;' % step.width)
+            body.append('\tstate.fw_set = 1;')
+        else:
+            body.append('\tstate.fw_set = 0;')
+        if step.prec == '*':
+            body.append('\tt = va_arg(hack, int);')
+            body.append('\tif (t < 0) {')
+            body.append('\t\ttpf_error(&state, "%d: precision cannot be negative", t);')
+            body.append('\t\tgoto fail;')
+            body.append('\t}')
+            body.append('\tstate.prec = t;')
+            body.append('\tstate.prec_set = 1;')
+        elif step.prec is not None:
+            body.append('\tstate.prec = %d;' % step.prec)
+            body.append('\tstate.prec_set = 1;')
+        else:
+            body.append('\tstate.prec_set = 0;')
+        body.append('\tstate.length = LENGTH_%s;' % (step.length or 'UNSET'))
+        if step.elem:
+            body.append('\tstate.fconv = fmt + %d;' % step.conv)
+        body.append('\tif (%s(&state, &hack) != 0)' % converter(step.spec))
+        body.append('\t\tgoto fail;')
+        body.append("\ttpf_repeat(&state, ' ', state.padding);")
+        body.append('\tstate.padding = 0;')
+
+    out = []
+    out.append('static int %s(const struct tpf_context *context, const struct tpf_output *output, va_list ap)' % name)
+    out.append('{')
+    out.append('\tstatic const char fmt[] = %s;' % c_string(fmt))
+    out.append('\tstruct tpf_state state = {.context = context};')
+    out.append('\tva_list hack;')
+    if star:
+        out.append('\tint t;')
+    out.append('')
+    out.append('\tstate.format = fmt;')
+    out.append('\tstate.output = output;')
+    out.append('\tva_copy(hack, ap);')
+    out.append('')
+    out.extend(body)
+    out.append('')
+    if stops:
+        out.append('done:')
+    out.append('\tva_end(hack);')
+    out.append('\treturn state.pos;')
+    if convs:
+        out.append('')
+        out.append('fail:')
+        out.append('\tva_end(hack);')
+        out.append('\treturn -1;')
+    out.append('}')
+    return '\n'.join(out)
+
+def sample_args(step, which):
+    """C expressions for the arguments a conversion takes; which picks a set."""
+    args = []
+    if step.width == '*':
+        args.append(('7', '0')[which])
+    if step.prec == '*':
+        args.append(('3', '0')[which])
+
+    s, l = step.spec, step.length
+    if s == 'v':
+        signed = step.elem in 'di'
+        ctype = {
+            'hh': 'signed char', 'h': 'short', 'l': 'long', 'll': 'long long',
+            'j': 'intmax_t', 't': 'ptrdiff_t', 'z': 'size_t', 'w128': '__int128',
+        }.get(l, 'int')
+        if not signed:
+            ctype = {'signed char': 'unsigned char', 'intmax_t': 'uintmax_t', '__int128': 'unsigned __int128'}.get(ctype, 'unsigned ' + ctype)
+        if ctype == 'unsigned size_t':
+            ctype = 'size_t'
+        values = ('-42, 0, 117', '0') if signed else ('200, 0, 7', '0')
+        args.append('(size_t) %d, (const %s[]) { %s }, %s' % (3 - 2 * which, ctype, values[which], ('NULL', '"|"')[which]))
+    elif s in 'di':
+        ctype = {'l': 'long', 'll': 'long long', 'j': 'intmax_t', 't': 'ptrdiff_t', 'w128': '__int128'}.get(l, 'int')
+        v = ('-42', '117')[which] if l in ('hh', 'h') else ('-42', '1234567')[which]
+        if l == 'w128':
+            v = ('-42', '(__int128) 1234567 * 1000000000 * 1000000000')[which]
+        args.append('(%s) %s' % (ctype, v))
+    elif s in 'ouxX':
+        ctype = {'l': 'unsigned long', 'll': 'unsigned long long', 'j': 'uintmax_t', 'z': 'size_t', 'w128': 'unsigned __int128'}.get(l, 'unsigned')
+        v = ('0', '200')[which] if l in ('hh', 'h') else ('0', '3054')[which]
+        if l == 'w128':
+            v = ('0', '(unsigned __int128) 3054 * 1000000000 * 1000000000')[which]
+        args.append('(%s) %s' % (ctype, v))
+    elif s == 'c':
+        args.append(("(wint_t) L'q'", "(wint_t) L'!'")[which] if l else ("'q'", "'!'")[which])
+    elif s == 's':
+        args.append(('L"wide"', 'L""')[which] if l else ('"sample"', '(const char *) NULL')[which])
+    elif s == 'V':
+        args.append(('(size_t) 2, L"wide"', '(size_t) 0, L""')[which] if l else ('(size_t) 4, "sample"', '(size_t) 0, ""')[which])
+    elif s == 'p':
+        args.append(('(void *) 0x1234', '(void *) NULL')[which])
+    elif s == 'n':
+        args.append('&n')
+    elif s in 'DT':
+        args.append(('&ts[0]', '&ts[1]')[which])
+    elif s in 'JQq':
+        args.append(('"a \\"b\\",c\\n"', '"plain"')[which])
+    return args
+
+def gen_test(formats):
+    out = []
+    out.append('/* Generated by tool/specialize.py. */')
+    out.append('')
+    out.append('#define _POSIX_C_SOURCE 200809L')
+    out.append('')
+    out.append('#include <stddef.h>')
+    out.append('#include <stdint.h>')
+    out.append('#include <stdio.h>')
+    out.append('#include <string.h>')
+    out.append('#include <time.h>')
+    out.append('#include <wchar.h>')
+    out.append('')
+    out.append('#include <tprintf.h>')
+    out.append('#include <tstd.h>')
+    out.append('#include <tstdio.h>')
+    out.append('')
+    out.append('int tprintf__specialize(struct tpf_context *);')
+    out.append('')
+    out.append('struct sink {')
+    out.append('\tchar buf[4096];')
+    out.append('\tsize_t len;')
+    out.append('};')
+    out.append('')
+    out.append('static size_t write_sink(void *arg, size_t len, const char *data)')
+    out.append('{')
+    out.append('\tstruct sink *sink = arg;')
+    out.append('')
+    out.append('\tif (len > sizeof sink->buf - sink->len)')
+    out.append('\t\tlen = sizeof sink->buf - sink->len;')
+    out.append('\tmemcpy(sink->buf + sink->len, data, len);')
+    out.append('\tsink->len += len;')
+    out.append('\treturn len;')
+    out.append('}')
+    out.append('')
+    out.append('static struct tpf_context special, plain;')
+    out.append('static struct sink a, b;')
+    specs = set(s.spec for fmt, literal, steps in formats for s in steps if isinstance(s, Conversion))
+    if 'n' in specs:
+        out.append('static int n;')
+    if specs & set('DT'):
+        out.append('static const struct timespec ts[] = { { 1700000000, 123456789 }, { 59, 5 } };')
+    out.append('')
+    out.append('static int run(const struct tpf_context *context, struct sink *sink, const char *fmt, ...)')
+    out.append('{')
+    out.append('\tstruct tpf_output out = { write_sink, sink };')
+    out.append('\tva_list ap;')
+    out.append('\tint r;')
+    out.append('')
+    out.append('\tsink->len = 0;')
+    out.append('\tva_start(ap, fmt);')
+    out.append('\tr = tvprintf(context, &out, fmt, ap);')
+    out.append('\tva_end(ap);')
+    out.append('\treturn r;')
+    out.append('}')
+    out.append('')
+    out.append('/* The test calls pass the literal from the source, so this finds misparsed ones. */')
+    out.append('static int compiled(const char *fmt)')
+    out.append('{')
+    out.append('\tstruct tpf_output out = tpf_output_FILE(stdout);')
+    out.append('\tsize_t i;')
+    out.append('')
+    out.append('\tfor (i = 0; i < special.nspecial; i++)')
+    out.append('\t\tif (strcmp(special.special[i].format, fmt) == 0)')
+    out.append('\t\t\treturn 1;')
+    out.append('')
+    out.append('\ttprintf(tprintf__context, &out, "XXX %#q: not among the compiled formats\\n", fmt);')
+    out.append('\treturn 0;')
+    out.append('}')
+    out.append('')
+    out.append('static int same(const char *fmt, int r1, int r2)')
+    out.append('{')
+    out.append('\tstruct tpf_output out = tpf_output_FILE(stdout);')
+    out.append('')
+    out.append('\tif (r1 == r2 && a.len == b.len && memcmp(a.buf, b.buf, a.len) == 0)')
+    out.append('\t\treturn 1;')
+    out.append('')
+    out.append('\ttprintf(tprintf__context, &out, "XXX %#q: compiled gave %d, %#.*q; tvprintf gave %d, %#.*q\\n",')
+    out.append('\t        fmt, r1, (int) a.len, a.buf, r2, (int) b.len, b.buf);')
+    out.append('\treturn 0;')
+    out.append('}')
+    out.append('')
+    out.append('int main(void)')
+    out.append('{')
+    out.append('\tint tests = 0, passed = 0;')
+    out.append('\tsize_t i;')
+    out.append('')
+    out.append('\ttprintf__init();')
+    out.append('\tspecial = *tprintf__context;')
+    out.append('\tplain = *tprintf__context;')
+    out.append('\tif (tprintf__specialize(&special) != 0) {')
+    out.append('\t\tprintf("XXX the context does not take the compiled formats\\n");')
+    out.append('\t\treturn 1;')
+    out.append('\t}')
+    out.append('')
+    out.append('\tfor (i = 1; i < special.nspecial; i++) {')
+    out.append('\t\tif (strcmp(special.special[i - 1].format, special.special[i].format) >= 0) {')
+    out.append('\t\t\tprintf("XXX specializations are out of order at %zu\\n", i);')
+    out.append('\t\t\treturn 1;')
+    out.append('\t\t}')
+    out.append('\t}')
+    out.append('')
+    for fmt, literal, steps in formats:
+        wide = any(isinstance(s, Conversion) and s.length == 'w128' for s in steps)
+        if wide:
+            out.append('#ifdef __SIZEOF_INT128__')
+        convs = any(isinstance(s, Conversion) for s in steps)
+        for which in (0, 1) if convs else (0,):
+            args = [literal]
+            for s in steps:
+                if isinstance(s, Conversion):
+                    args += sample_args(s, which)
+            call = ', '.join(args)
+            out.append('\ttests++;')
+            out.append('\tpassed += compiled(%s) && same(%s, run(&special, &a, %s), run(&plain, &b, %s));' % (literal, literal, call, call))
+        if wide:
+            out.append('#endif')
+    out.append('')
+    out.append('\tprintf("%d tests, %d passed\\n", tests, passed);')
+    out.append('\treturn passed != tests;')
+    out.append('}')
+    return '\n'.join(out) + '\n'
+
+def gen_source(header, formats):
+    out = []
+    out.append('/* Generated by tool/specialize.py. */')
+    out.append('')
+    out.append('#include <stdarg.h>')
+    out.append('#include <stddef.h>')
+    out.append('#include <string.h>')
+    out.append('')
+    out.append('#include <tprintf.h>')
+    out.append('#include <tstd.h>')
+    out.append('')
+    out.append('#include "%s"' % header)
+    out.append('')
+    out.append('/*')
+    out.append(' * The converters are called directly, so these only stand in for tvprintf()')
+    out.append(' * when the context has them registered, with the flags tstd.c gives them.')
+    out.append(' */')
+    for n, (fmt, literal, steps) in enumerate(formats):
+        out.append(gen_function('spec_%d' % n, fmt, steps))
+        out.append('')
+    if formats:
+        out.append('static const struct tpf_special specials[] = {')
+        for n, (fmt, literal, steps) in enumerate(formats):
+            out.append('\t{ %s, spec_%d },' % (c_string(fmt), n))
+        out.append('};')
+        out.append('')
+    specs = sorted(set(s.spec for fmt, literal, steps in formats for s in steps if isinstance(s, Conversion)))
+    out.append('int tprintf__specialize(struct tpf_context *context)')
+    out.append('{')
+    out.append('\tstatic const struct {')
+    out.append('\t\tchar spec;')
+    out.append('\t\tconst char *flags;')
+    out.append('\t\tint (*callback)(struct tpf_state *, va_list *);')
+    out.append('\t} uses[] = {')
+    for spec in specs:
+        flags = bytes(sorted(CONVERSIONS[spec][0].encode()))
+        out.append("\t\t{ %s, %s, %s }," % (c_char(spec), c_string(flags), converter(spec)))
+    out.append('\t\t{ 0 }')
+    out.append('\t};')
+    out.append('\tsize_t i;')
+    out.append('')
+    out.append('\tfor (i = 0; uses[i].spec; i++) {')
+    out.append('\t\tconst struct tpf_format *f = context->fmts[(unsigned char) uses[i].spec];')
+    out.append('\t\tif (!f || f->callback != uses[i].callback || strcmp(f->flags, uses[i].flags) != 0)')
+    out.append('\t\t\treturn -1;')
+    out.append('\t}')
+    out.append('')
+    if formats:
+        out.append('\ttpf_specialize(context, specials, sizeof specials / sizeof *specials);')
+    else:
+        out.append('\ttpf_specialize(context, NULL, 0);')
+    out.append('\treturn 0;')
+    out.append('}')
+    return '\n'.join(out) + '\n'
+
+def gen_header(guard):
+    return '\n'.join([
+        '/* Generated by tool/specialize.py. */',
+        '',
+        '#ifndef %s' % guard,
+        '#define %s' % guard,
+        '',
+        '#include <tprintf.h>',
+        '',
+        '/*',
+        ' * Makes tvprintf() with context use the compiled formats. Returns -1, and',
+        ' * leaves the context as it was, unless every conversion they use is the one',
+        ' * tprintf__init() registers; that must stay so for as long as they are used.',
+        ' */',
+        'int tprintf__specialize(struct tpf_context *);',
+        '',
+        '#endif',
+    ]) + '\n'
+
+def main(argv):
+    if len(argv) < 2:
+        print("usage: specialize.py OUT SOURCE...", file=sys.stderr)
+        return 2
+
+    out, sources = argv[0], argv[1:]
+    # each format, and one of the literals it was written as
+    found = {}
+    for path in sources:
+        for fmt, literal in scan(path):
+            found.setdefault(fmt, literal)
+
+    formats = []
+    for fmt in sorted(found):
+        steps = parse(fmt)
+        if steps is not None:
+            formats.append((fmt, found[fmt], steps))
+
+    header = os.path.basename(out) + '.h'
+    guard = re.sub(r'\W', '_', header).upper()
+    with open(out + '.h', 'w') as f:
+        f.write(gen_header(guard))
+    with open(out + '.c', 'w') as f:
+        f.write(gen_source(header, formats))
+    # the literals are copied from sources read as latin-1
+    with open(out + '_test.c', 'w', encoding='latin-1') as f:
+        f.write(gen_test(formats))
+
+    print("{} of {} formats compiled".format(len(formats), len(found)))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -17,15 +17,25 @@ except:
 def escape(s):
     return s.replace('\\', '\\\\').replace('\"', '\\"')
 
+INT_RANGES = (
+    ('hh', 8,  'int'),
+    ('h',  16, 'int'),
+    ('',   32, 'int'),
+    ('l',  64, 'long'),
+    ('ll', 64, 'long long')
+)
+
+# what the elements of an array are, for each length modifier
+ELEMENT_TYPES = {
+    'hh': 'char',
+    'h':  'short',
+    '':   'int',
+    'l':  'long',
+    'll': 'long long',
+}
+
 def gen_int_range(r, signed=True):
-    ranges = (
-        ('hh', 8,  'int'),
-        ('h',  16, 'int'),
-        ('',   32, 'int'),
-        ('l',  64, 'long'),
-        ('ll', 64, 'long long')
-    )
-    m, b, s = r.choice(ranges)
+    m, b, s = r.choice(INT_RANGES)
     n = r.randint(0, 2 ** b - 1)
     if signed:
         n -= 2 ** (b - 1)
@@ -33,10 +43,9 @@ def gen_int_range(r, signed=True):
         s = 'unsigned ' + s
     return m, ffi.cast(s, n)
 
-def gen_int_meta(r):
+def gen_int_meta(r, flags=' +-0'):
     o = ''
     a = []
-    flags = ' +-0'
     o += ''.join(r.sample(flags, r.randint(0, len(flags))))
     fw = r.randint(-20, 20)
     if fw < 0:
@@ -60,7 +69,7 @@ def gen_int(r):
 
 def gen_unsigned(r):
     s = r.choice("ouxX")
-    m, a = gen_int_meta(r)
+    m, a = gen_int_meta(r, ' +-0#' if s != 'u' else ' +-0')
     lm, n = gen_int_range(r, signed=False)
     return '%' + m + lm + s, a + [n]
 
@@ -73,23 +82,70 @@ def gen_str(r):
     else:
         return '%s', [ffi.new('char[]', s.encode())]
 
+def gen_wstr(r):
+    """
+    %ls, with a precision half the time, in which case the array has no NUL:
+    nothing past the precision may be read.
+    """
+    l = math.floor(r.triangular(0, 30, 0))
+    s = ''.join(r.choice(string.ascii_letters) for i in range(l))
+    o = r.choice(('', '-'))
+    fw = r.randint(0, 20)
+    if fw:
+        o += str(fw)
+    if r.randint(0, 1) == 0:
+        return '%' + o + 'ls', [ffi.new('wchar_t[]', s)]
+    return '%' + o + '.' + str(r.randint(0, l)) + 'ls', [ffi.new('wchar_t[%d]' % l, s) if l else ffi.NULL]
+
+def gen_array(r):
+    """
+    An array conversion for tprintf, and what libc is given for the same thing:
+    one conversion per element, with the separator in between.
+    """
+    s = r.choice("diuoxX")
+    signed = s in "di"
+    m, a = gen_int_meta(r, ' +-0' if s in "diu" else ' +-0#')
+    lm, b, _ = r.choice(INT_RANGES)
+    n = math.floor(r.triangular(0, 20, 0))
+    values = [r.randint(0, 2 ** b - 1) - (2 ** (b - 1) if signed else 0) for i in range(n)]
+    # now and then one longer than %v's chunk, which has to be written on its own
+    sep = r.choice((None, ' ', '|', '\t', ',' * r.choice((300, 6000))))
+
+    t = ELEMENT_TYPES[lm]
+    t = ('signed ' if signed else 'unsigned ') + t
+    array = ffi.new(t + '[]', values) if n else ffi.NULL
+    sarg = ffi.new('char[]', sep.encode()) if sep is not None else ffi.NULL
+
+    scalar = dict((rm, rs) for rm, rb, rs in INT_RANGES)[lm]
+    if not signed:
+        scalar = 'unsigned ' + scalar
+    lfmt = (', ' if sep is None else sep).join('%' + m + lm + s for v in values)
+    largs = [x for v in values for x in a + [ffi.cast(scalar, v)]]
+
+    return ('%' + m + lm + 'v' + s, a + [ffi.cast('size_t', n), array, sarg],
+            lfmt, largs)
+
 def gen_arg(r):
-    return r.choice((gen_int, gen_unsigned, gen_str))(r)
+    return r.choice((gen_int, gen_unsigned, gen_str, gen_wstr, gen_array))(r)
 
 def gen_call(r):
+    """The same call as it is made to tprintf, and to libc."""
     pieces = r.randint(1, 5)
-    fmt = ""
-    args = []
+    fmt, lfmt = "", ""
+    args, largs = [], []
     for i in range(pieces):
-        f, a = gen_arg(r)
+        x = gen_arg(r)
+        f, a, lf, la = x if len(x) == 4 else x + x
         fmt += f
-        if a is not None:
-            args.extend(a)
-    return [ffi.new('char[]', fmt.encode())] + args
+        lfmt += lf
+        args.extend(a)
+        largs.extend(la)
+    return ([ffi.new('char[]', fmt.encode())] + args,
+            [ffi.new('char[]', lfmt.encode())] + largs)
 
 def test_one(i, r, buf1, buf2, quiet):
-    a = gen_call(r)
-    tpf.snprintf(buf1, ffi.sizeof(buf1), *a)
+    a, la = gen_call(r)
+    tpf.snprintf(buf1, ffi.sizeof(buf1), *la)
     tpf.tprintf_snprintf(buf2, ffi.sizeof(buf2), *a)
     if not quiet:
         tpf.puts(buf2)
@@ -0,0 +1,324 @@
+"""
+Test the conversions tprintf has and libc doesn't against references written
+in Python, with randomly generated calls.
+"""
+
+import os
+import random
+import time
+
+try:
+    from _test_lib import lib as tpf, ffi
+except:
+    tpf = None
+    print("tprintf python bindings missing, please `make test_lib`.")
+
+buf = None
+
+def tprintf(fmt, *args):
+    tpf.tprintf_snprintf(buf, ffi.sizeof(buf), fmt.encode(), *args)
+    # %J passes bytes past ASCII through
+    return ffi.string(buf).decode('latin-1')
+
+def pad(s, flags, fw):
+    return s.ljust(fw) if '-' in flags else s.rjust(fw)
+
+def gen_meta(r, flags):
+    """Flags, width and precision; the precision may be past the 9 allowed."""
+    f = ''.join(r.sample(flags, r.randint(0, len(flags))))
+    fw = r.choice((0, 0, r.randint(1, 40)))
+    prec = r.choice((None, r.randint(0, 12)))
+    o = f + (str(fw) if fw else '') + ('' if prec is None else '.' + str(prec))
+    return o, f, fw, min(prec or 0, 9)
+
+def fraction(nsec, prec):
+    return '.' + ('%09d' % nsec)[:prec] if prec else ''
+
+def timespec(sec, nsec):
+    return ffi.new('struct timespec *', (sec, nsec))
+
+def ref_time(sec, nsec, utc, prec):
+    if utc:
+        return time.strftime('%Y-%m-%dT%H:%M:%S', time.gmtime(sec)) + fraction(nsec, prec) + 'Z'
+    return time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(sec)) + fraction(nsec, prec)
+
+def transitions(start, end):
+    """The seconds at which the local offset from UTC changes in [start, end)."""
+    out = []
+    for t in range(start, end, 3600):
+        if time.localtime(t).tm_gmtoff != time.localtime(t + 3600).tm_gmtoff:
+            lo, hi = t, t + 3600
+            while hi - lo > 1:
+                mid = (lo + hi) // 2
+                if time.localtime(mid).tm_gmtoff == time.localtime(t).tm_gmtoff:
+                    lo = mid
+                else:
+                    hi = mid
+            out.append(hi)
+    return out
+
+def walk(r, t):
+    """Seconds from a little before t to a little after, mostly going forward."""
+    sec = t - r.randint(60, 150)
+    while sec < t + 150:
+        yield sec
+        sec += r.choice((0, 1, 1, 1, 2, 7, 59, 60, 61, -1, -60))
+
+def test_time(r, n):
+    """
+    %T caches the rendered minute and patches in the seconds, so calls go
+    forward through minute and DST boundaries as well as jumping about.
+    """
+    ok = fail = 0
+    for zone in ('UTC', 'America/New_York', 'Europe/London', 'Australia/Lord_Howe', 'Asia/Kolkata'):
+        os.environ['TZ'] = zone
+        time.tzset()
+        # a change of TZ is only noticed with the minute
+        tprintf('%T', timespec(0, 0))
+
+        times = [s for t in transitions(1704067200, 1735689600) for s in walk(r, t)]
+        times += [s for i in range(n // 100) for s in walk(r, r.randint(0, 2 ** 32))]
+        times += [r.randint(-2 ** 31, 2 ** 33) for i in range(n // 10)]
+        for sec in times:
+            nsec = r.choice((0, 999999999, r.randint(0, 999999999)))
+            o, f, fw, prec = gen_meta(r, '-#')
+            fmt = '%' + o + 'T'
+            got = tprintf(fmt, timespec(sec, nsec))
+            want = pad(ref_time(sec, nsec, '#' in f, prec), f, fw)
+            if got == want:
+                ok += 1
+            else:
+                fail += 1
+                print("XXX TZ={} {!r} of {}.{:09}: got {!r}, expected {!r}".format(zone, fmt, sec, nsec, got, want))
+
+        # past any year a struct tm can hold
+        for fmt in (b'%T', b'%#T'):
+            ret = tpf.tprintf_snprintf(buf, ffi.sizeof(buf), fmt, timespec(2 ** 60, 0))
+            if ret == -1:
+                ok += 1
+            else:
+                fail += 1
+                print("XXX TZ={} {!r} of 2^60 seconds gave {}, not -1".format(zone, fmt, ret))
+    return ok, fail
+
+def ref_duration(sec, nsec, flags, prec):
+    neg = sec < 0
+    if neg and nsec:
+        sec, nsec = -sec - 1, 10 ** 9 - nsec
+    elif neg:
+        sec = -sec
+    if '#' in flags:
+        s = '%d:%02d:%02d' % (sec // 3600, sec // 60 % 60, sec % 60)
+    else:
+        s = str(sec)
+    sign = '-' if neg else '+' if '+' in flags else ' ' if ' ' in flags else ''
+    return sign + s + fraction(nsec, prec)
+
+def test_duration(r, n):
+    ok = fail = 0
+    for i in range(n):
+        b = r.choice((8, 17, 32, 63))
+        sec = r.randint(-2 ** b, 2 ** b - 1)
+        nsec = r.choice((0, 1, 999999999, r.randint(0, 999999999)))
+        o, f, fw, prec = gen_meta(r, ' +-#')
+        fmt = '%' + o + 'D'
+        got = tprintf(fmt, timespec(sec, nsec))
+        want = pad(ref_duration(sec, nsec, f, prec), f, fw)
+        if got == want:
+            ok += 1
+        else:
+            fail += 1
+            print("XXX {!r} of {}.{:09}: got {!r}, expected {!r}".format(fmt, sec, nsec, got, want))
+    return ok, fail
+
+C_ESCAPES = {
+    '"': '\\"', '\\': '\\\\', '\b': '\\b', '\f': '\\f', '\n': '\\n', '\r': '\\r',
+    '\t': '\\t', '\a': '\\a', '\v': '\\v',
+}
+
+def ref_escaped(spec, s, flags):
+    if spec == 'Q':
+        if '#' not in flags and not any(c in s for c in '",\n\r'):
+            return s
+        return '"' + s.replace('"', '""') + '"'
+    if spec == 'J':
+        e = ''.join(c if ord(c) >= 0x20 and c not in '"\\' else
+                    C_ESCAPES[c] if c in C_ESCAPES and c not in '\a\v' else
+                    '\\u%04x' % ord(c) for c in s)
+    else:
+        e = ''.join(c if 0x20 <= ord(c) < 0x7f and c not in '"\\' else
+                    C_ESCAPES.get(c, '\\%03o' % ord(c)) for c in s)
+    return '"' + e + '"' if '#' in flags else e
+
+def gen_escapable(r):
+    """
+    Mostly plain text, which the SIMD scan goes through 16 bytes at a time, with
+    special characters here and there; often at a block boundary.
+    """
+    l = r.choice((r.randint(0, 40), r.randint(0, 200)))
+    s = [r.choice('abcdefghijklmnop ') for i in range(l)]
+    for i in range(r.choice((0, 1, 3, l // 4))):
+        if not l:
+            break
+        pos = r.choice((r.randrange(l), min(l - 1, r.choice((15, 16, 31, 32)))))
+        s[pos] = chr(r.choice((r.randint(1, 0x1f), r.randint(0x7f, 0xff), ord(r.choice('"\\,\'')))))
+    return ''.join(s)
+
+def test_escaped(r, n):
+    """
+    %J, %Q and %q. With a precision the argument has no NUL, as nothing past the
+    precision may be read.
+    """
+    ok = fail = 0
+    for i in range(n):
+        spec = r.choice('JQq')
+        s = gen_escapable(r)
+        o, f, fw, prec = gen_meta(r, '-#')
+        fmt = '%' + o + spec
+        if '.' in o:
+            prec = int(o.split('.')[1])
+            s = s[:prec]
+            arg = ffi.new('char[%d]' % prec, s.encode('latin-1')) if prec else ffi.NULL
+        else:
+            arg = ffi.new('char[]', s.encode('latin-1'))
+        got = tprintf(fmt, arg)
+        want = pad(ref_escaped(spec, s, f), f, fw)
+        if got == want:
+            ok += 1
+        else:
+            fail += 1
+            print("XXX {!r} of {!r}: got {!r}, expected {!r}".format(fmt, s, got, want))
+    return ok, fail
+
+def ref_int(v, spec, flags, fw, prec):
+    """What C does with an integer conversion, v already signed or not."""
+    digits = format(abs(v), {'o': 'o', 'x': 'x', 'X': 'X'}.get(spec, 'd'))
+    if prec == 0 and v == 0:
+        digits = ''
+    if prec is not None:
+        digits = digits.rjust(prec, '0')
+    if spec == 'o' and '#' in flags and not digits.startswith('0'):
+        digits = '0' + digits
+    prefix = '0' + spec if spec in 'xX' and '#' in flags and v else ''
+    sign = ''
+    if spec in 'di':
+        sign = '-' if v < 0 else '+' if '+' in flags else ' ' if ' ' in flags else ''
+    if '-' in flags:
+        return (sign + prefix + digits).ljust(fw)
+    if '0' in flags and prec is None:
+        return sign + prefix + digits.rjust(fw - len(sign) - len(prefix), '0')
+    return (sign + prefix + digits).rjust(fw)
+
+def gen_w128(r, signed):
+    """Mostly values past 64 bits, and around where 10^9 divisions end."""
+    v = r.choice((
+        r.getrandbits(r.randint(1, 128)),
+        10 ** r.randint(9, 38) + r.randint(-2, 2),
+        2 ** 64 + r.randint(-2, 2),
+        r.choice((0, 2 ** 127 - 1, 2 ** 127, 2 ** 128 - 1)),
+    )) % 2 ** 128
+    if signed and v >= 2 ** 127:
+        v -= 2 ** 128
+    return v
+
+def halves(v):
+    v %= 2 ** 128
+    return v >> 64, v & (2 ** 64 - 1)
+
+def test_w128(r, n):
+    """The w128 length modifier, alone and for %v."""
+    ok = fail = 0
+    for i in range(n):
+        spec = r.choice('diuoxX')
+        flags = ''.join(r.sample(' +-0#', r.randint(0, 5)))
+        if spec in 'diu':
+            flags = flags.replace('#', '')
+        fw = r.choice((0, r.randint(1, 50)))
+        prec = r.choice((None, None, r.randint(0, 45)))
+        o = flags + (str(fw) if fw else '') + ('' if prec is None else '.' + str(prec))
+        signed = spec in 'di'
+
+        if r.randint(0, 3):
+            v = gen_w128(r, signed)
+            fmt = '%' + o + 'w128' + spec
+            tpf.w128_snprintf(buf, ffi.sizeof(buf), fmt.encode(), *halves(v))
+            want = ref_int(v, spec, flags, fw, prec)
+            what = repr(v)
+        else:
+            values = [gen_w128(r, signed) for j in range(r.randint(0, 16))]
+            sep = r.choice((None, ' ', '|'))
+            fmt = '%' + o + 'w128v' + spec
+            array = ffi.new('unsigned long long[]', [h for v in values for h in halves(v)] or [0])
+            tpf.w128v_snprintf(buf, ffi.sizeof(buf), fmt.encode(), len(values), array,
+                               ffi.new('char[]', sep.encode()) if sep is not None else ffi.NULL)
+            want = (', ' if sep is None else sep).join(ref_int(v, spec, flags, fw, prec) for v in values)
+            what = repr(values)
+
+        got = ffi.string(buf).decode()
+        if got == want:
+            ok += 1
+        else:
+            fail += 1
+            print("XXX {!r} of {}: got {!r}, expected {!r}".format(fmt, what, got, want))
+    return ok, fail
+
+def test_slprintf(r, n):
+    """
+    tprintf_slprintf returns the length if it all fit and the buffer size if
+    not, never writes past the buffer, and stores no %n past where it stopped.
+    """
+    ok = fail = 0
+    for i in range(n):
+        a = 'a' * r.randint(0, 30)
+        b = 'b' * r.randint(0, 30)
+        fw = r.randint(0, 40)
+        size = r.randint(0, 70)
+        full = a + b.rjust(fw)
+
+        out = ffi.new('char[]', size + 8)
+        ffi.memmove(out, b'#' * (size + 8), size + 8)
+        count = ffi.new('int *', -1)
+        got = tpf.tprintf_slprintf(out, size, b'%s%n%*s', ffi.new('char[]', a.encode()), count,
+                                   ffi.cast('int', fw), ffi.new('char[]', b.encode()))
+
+        want = len(full) if len(full) < size else size
+        text = full[:max(size - 1, 0)]
+        after = ffi.buffer(out)[size:]
+        problems = []
+        if got != want:
+            problems.append('returned {}, not {}'.format(got, want))
+        if size and ffi.string(out).decode() != text:
+            problems.append('wrote {!r}, not {!r}'.format(ffi.string(out).decode(), text))
+        if after != b'#' * 8:
+            problems.append('wrote past the buffer')
+        # nothing is cut off before the %n if there was nothing to write
+        if count[0] != (len(a) if len(a) < size or not a else -1):
+            problems.append('stored {} for %n'.format(count[0]))
+
+        if not problems:
+            ok += 1
+        else:
+            fail += 1
+            print("XXX slprintf of {!r}, {}, {!r} into {}: {}".format(a, fw, b, size, '; '.join(problems)))
+    return ok, fail
+
+TESTS = (test_time, test_duration, test_escaped, test_w128, test_slprintf)
+
+def main(n='1000'):
+    global buf
+
+    tpf.tprintf__init()
+    r = random.Random()
+    buf = ffi.new("char[]", 5000)
+    ok = fail = 0
+    for test in TESTS:
+        o, f = test(r, int(n))
+        ok += o
+        fail += f
+    tpf.fflush(tpf.stdout)
+    print("{} tests, {} passed".format(ok + fail, ok))
+
+
+if tpf is not None and __name__ == '__main__':
+    import sys
+    main(*sys.argv[1:])
@@ -16,20 +16,121 @@ def setup():
     os.chdir(os.path.dirname(__file__))
     ffi.set_source("_test_lib",
         """
+        #define _GNU_SOURCE
+        #include <dlfcn.h>
+        #include <stdarg.h>
         #include <stddef.h>
         #include <stdio.h>
+        #include <stdlib.h>
         #include <string.h>
+        #include <time.h>
 
         void tprintf__init(void);
         int tprintf_snprintf(char *, size_t, const char *, ...);
+        int tprintf_slprintf(char *, size_t, const char *, ...);
+
+        /* libc's own snprintf, even with the preload library in front */
+        int libc_snprintf(char *str, size_t n, const char *fmt, ...)
+        {
+            static int (*f)(char *, size_t, const char *, va_list);
+            va_list ap;
+            int r;
+
+            if (!f)
+                f = dlsym(dlopen("libc.so.6", RTLD_LAZY), "vsnprintf");
+
+            va_start(ap, fmt);
+            r = f(str, n, fmt, ap);
+            va_end(ap);
+            return r;
+        }
+
+        int libc_fprintf(FILE *f, const char *fmt, ...)
+        {
+            static int (*vf)(FILE *, const char *, va_list);
+            va_list ap;
+            int r;
+
+            if (!vf)
+                vf = dlsym(dlopen("libc.so.6", RTLD_LAZY), "vfprintf");
+
+            va_start(ap, fmt);
+            r = vf(f, fmt, ap);
+            va_end(ap);
+            return r;
+        }
+
+        int libc_asprintf(char **strp, const char *fmt, ...)
+        {
+            static int (*vf)(char **, const char *, va_list);
+            va_list ap;
+            int r;
+
+            if (!vf)
+                vf = dlsym(dlopen("libc.so.6", RTLD_LAZY), "vasprintf");
+
+            va_start(ap, fmt);
+            r = vf(strp, fmt, ap);
+            va_end(ap);
+            return r;
+        }
+
+        /* cffi has no __int128, so these build them from 64-bit halves. */
+        int w128_snprintf(char *str, size_t n, const char *fmt,
+                          unsigned long long hi, unsigned long long lo)
+        {
+            return tprintf_snprintf(str, n, fmt, (unsigned __int128) hi << 64 | lo);
+        }
+
+        int w128v_snprintf(char *str, size_t n, const char *fmt, size_t count,
+                           const unsigned long long *halves, const char *sep)
+        {
+            unsigned __int128 v[16];
+            size_t i;
+
+            for (i = 0; i < count && i < 16; i++)
+                v[i] = (unsigned __int128) halves[2 * i] << 64 | halves[2 * i + 1];
+            return tprintf_snprintf(str, n, fmt, count, v, sep);
+        }
+
+        int preload_stats(unsigned long *tprintf, unsigned long *libc)
+        {
+            void (*f)(unsigned long *, unsigned long *) =
+                dlsym(RTLD_DEFAULT, "tprintf_preload_stats");
+            if (!f)
+                return -1;
+            f(tprintf, libc);
+            return 0;
+        }
         """,
-        extra_link_args=[os.path.abspath('../tprintf.so')])
+        extra_link_args=[os.path.abspath('../tprintf.so'), '-ldl'])
     ffi.cdef(
         """
         void tprintf__init(void);
         int tprintf_snprintf(char *, size_t, const char *, ...);
+        int tprintf_slprintf(char *, size_t, const char *, ...);
+        int libc_snprintf(char *, size_t, const char *, ...);
+        int libc_fprintf(FILE *, const char *, ...);
+        int libc_asprintf(char **, const char *, ...);
+        int preload_stats(unsigned long *, unsigned long *);
+        int w128_snprintf(char *, size_t, const char *, unsigned long long, unsigned long long);
+        int w128v_snprintf(char *, size_t, const char *, size_t, const unsigned long long *, const char *);
+
+        struct timespec {
+            long tv_sec;
+            long tv_nsec;
+        };
 
         int snprintf(char *str, size_t size, const char *format, ...);
+        int fprintf(FILE *stream, const char *format, ...);
+        int asprintf(char **strp, const char *format, ...);
+        FILE *tmpfile(void);
+        FILE *fopen(const char *path, const char *mode);
+        int fclose(FILE *stream);
+        long ftell(FILE *stream);
+        void rewind(FILE *stream);
+        size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream);
+        void free(void *ptr);
         int strcmp(const char *s1, const char *s2);
         int puts(const char *s);
         int fflush(FILE *stream);
@@ -0,0 +1,305 @@
+/*
+ * Check what tprintf's own outputs and renderers write against what they are
+ * expected to, where there is no libc to compare with.
+ *
+ *   test_output
+ *
+ * Output follows tool/test.py: XXX lines for failures, then a summary.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tprintf.h>
+#include <tstd.h>
+#include <tstdio.h>
+#include <ttable.h>
+
+/* A growbuf that also keeps track of its end hook. */
+struct sink {
+	struct tpf_growbuf buf;
+	int ends, result;
+};
+
+static int tests, passed;
+
+static size_t write_sink(void *arg, size_t len, const char *data)
+{
+	struct sink *sink = arg;
+	struct tpf_output out = tpf_output_growbuf(&sink->buf);
+
+	return out.writer(out.opaque, len, data);
+}
+
+static void end_sink(void *arg, int result)
+{
+	struct sink *sink = arg;
+
+	sink->ends++;
+	sink->result = result;
+}
+
+/* Takes nothing, as a full disk would. */
+static size_t write_fail(void *arg, size_t len, const char *data)
+{
+	return 0;
+}
+
+static void reset_sink(struct sink *sink)
+{
+	sink->buf.len = 0;
+	sink->ends = 0;
+	sink->result = 0;
+}
+
+static struct tpf_output output_sink(struct sink *sink)
+{
+	struct tpf_output out = { write_sink, sink, end_sink };
+
+	reset_sink(sink);
+	return out;
+}
+
+static void check(int ok, const char *what)
+{
+	tests++;
+	if (ok)
+		passed++;
+	else
+		printf("XXX %s\n", what);
+}
+
+/*
+ * The sink must hold want and have ended once, with r: what the call returned,
+ * which is want's length unless it failed.
+ */
+static void expect(const char *what, struct sink *sink, int r, const char *want)
+{
+	const struct tpf_output out = tpf_output_FILE(stdout);
+	int ok = sink->ends == 1 && sink->result == r && (r < 0 || (size_t) r == strlen(want)) &&
+	         sink->buf.len == strlen(want) && memcmp(sink->buf.data, want, sink->buf.len) == 0;
+
+	tests++;
+	if (ok) {
+		passed++;
+		return;
+	}
+	tprintf(tprintf__context, &out, "XXX %s: ended %d times with %d, wrote %#.*q\n",
+	        what, sink->ends, sink->result, (int) sink->buf.len, sink->buf.data);
+	tprintf(tprintf__context, &out, "XXX %s: expected %#q, ending with %d\n", what, want, r);
+}
+
+/* Tables */
+
+struct item {
+	const char *name;
+	int count;
+};
+
+static const struct item items[] = {
+	{ "apple", 3 },
+	{ "kiwi", 12345 },
+	{ "", -7 },
+};
+
+/* A header, then items; rows past the items are left short, or overfilled. */
+static int item_row(struct tpf_row *row, size_t i, void *arg)
+{
+	int *extra = arg;
+
+	if (i == 0) {
+		tpf_cellf(row, "NAME");
+		tpf_cellf(row, "N");
+		return 0;
+	}
+	if (--i < sizeof items / sizeof *items) {
+		tpf_cell(row, items[i].name);
+		tpf_cell(row, items[i].count);
+		return 0;
+	}
+
+	tpf_cellf(row, "%s-%zu", "short", i);
+	if (*extra) {
+		tpf_cellf(row, "1");
+		tpf_cellf(row, "2");
+	}
+	return 0;
+}
+
+static int item_table(struct sink *sink, const char *sep, int left, size_t nrows, int extra)
+{
+	struct tpf_column columns[] = {
+		{ "%s", 1 },
+		{ "%d", left },
+	};
+	struct tpf_table table = { columns, 2, nrows, sep, item_row, &extra };
+	struct tpf_output out = output_sink(sink);
+
+	return tpf_table(tprintf__context, &out, &table);
+}
+
+static int empty_row(struct tpf_row *row, size_t i, void *arg)
+{
+	return tpf_cell(row, "") < 0;
+}
+
+static size_t write_count(void *arg, size_t len, const char *data)
+{
+	*(size_t *) arg += len;
+	return len;
+}
+
+static void test_table(void)
+{
+	struct sink sink = { { 0 } };
+	int r;
+
+	r = item_table(&sink, "  ", 0, 4, 0);
+	expect("table", &sink, r,
+	       "NAME       N\n"
+	       "apple      3\n"
+	       "kiwi   12345\n"
+	       "          -7\n");
+
+	/* Short rows get empty cells; the last column is never padded. */
+	r = item_table(&sink, " | ", 1, 5, 0);
+	expect("left-aligned table", &sink, r,
+	       "NAME    | N\n"
+	       "apple   | 3\n"
+	       "kiwi    | 12345\n"
+	       "        | -7\n"
+	       "short-3 | \n");
+
+	r = item_table(&sink, NULL, 0, 1, 0);
+	expect("header only", &sink, r, "NAME N\n");
+
+	r = item_table(&sink, NULL, 0, 0, 0);
+	expect("empty table", &sink, r, "");
+
+	/* Too many cells in a row fails the whole table, before any of it is written. */
+	r = item_table(&sink, NULL, 0, 5, 1);
+	expect("overfull row", &sink, r, "");
+
+	free(sink.buf.data);
+}
+
+/* Longer than an int can say: two rows of padding half that long each. */
+static void test_table_overflow(void)
+{
+	struct tpf_column column = { "%s", 0, INT_MAX / 2 + 1 };
+	struct tpf_table table = { &column, 1, 2, NULL, empty_row };
+	size_t written = 0;
+	struct tpf_output out = { write_count, &written };
+	int r;
+
+	errno = 0;
+	r = tpf_table(tprintf__context, &out, &table);
+	check(r == -1 && errno == EOVERFLOW, "a table longer than INT_MAX didn't fail with EOVERFLOW");
+	check(written == 2 * ((size_t) INT_MAX / 2 + 2), "a table longer than INT_MAX wasn't written whole");
+}
+
+/* Tees */
+
+static void test_tee(void)
+{
+	struct sink a = { { 0 } }, b = { { 0 } }, c = { { 0 } };
+	struct tpf_tee_child children[] = {
+		{ { write_sink, &a, end_sink } },
+		{ { write_fail, &b, end_sink } },
+		{ { write_sink, &c, end_sink } },
+	};
+	struct tpf_tee tee = { children, 3 };
+	struct tpf_output out = tpf_output_tee(&tee);
+	char long_text[1000];
+	int r;
+
+	/* Each call reaches every child whole, and one failing holds up no other. */
+	reset_sink(&a);
+	reset_sink(&b);
+	reset_sink(&c);
+	r = tprintf(tprintf__context, &out, "%s=%d", "key", 42);
+	expect("first child of a tee", &a, r, "key=42");
+	expect("last child of a tee", &c, r, "key=42");
+	check(b.ends == 1 && b.result == r, "a tee's failing child wasn't ended with the result");
+	check(children[0].errors == 0 && children[1].errors == 1 && children[2].errors == 0,
+	      "a tee's children counted the wrong errors");
+
+	/* Longer than the stage has room for yet */
+	memset(long_text, 'x', sizeof long_text - 1);
+	long_text[sizeof long_text - 1] = 0;
+	reset_sink(&a);
+	reset_sink(&c);
+	r = tprintf(tprintf__context, &out, "%s", long_text);
+	expect("first child of a tee, after growing", &a, r, long_text);
+	expect("last child of a tee, after growing", &c, r, long_text);
+
+	/* As when realloc fails part of the way: nobody gets a piece of it. */
+	reset_sink(&a);
+	reset_sink(&c);
+	tee.stage.failed = 1;
+	tprintf(tprintf__context, &out, "%s", "lost");
+	expect("tee that couldn't stage the call", &a, -1, "");
+	expect("tee that couldn't stage the call", &c, -1, "");
+	check(children[0].errors == 1 && children[1].errors == 3 && children[2].errors == 1,
+	      "a tee that couldn't stage the call didn't count it against every child");
+
+	reset_sink(&a);
+	reset_sink(&c);
+	r = tprintf(tprintf__context, &out, "%s", "again");
+	expect("tee after a failed call", &a, r, "again");
+
+	free(a.buf.data);
+	free(b.buf.data);
+	free(c.buf.data);
+	tpf_tee_fini(&tee);
+}
+
+/* Error messages */
+
+static void test_error(void)
+{
+	struct tpf_context context = *tprintf__context;
+	struct sink errors = { { 0 } }, sink = { { 0 } };
+	struct tpf_output error = output_sink(&errors);
+	struct tpf_output out = output_sink(&sink);
+	int r;
+
+	context.error = &error;
+	r = tprintf(&context, &out, "%d and %\x01", 1);
+
+	check(r < 0, "a bad conversion didn't fail the call");
+	check(sink.ends == 1 && sink.result == r, "a failed call didn't end its output once, with its result");
+	check(errors.ends == 1 && errors.buf.len > 7 && memcmp(errors.buf.data, "ERROR:\n", 7) == 0,
+	      "an error message wasn't one call to its output");
+
+	/* A format that ends where %v's element conversion should be */
+	reset_sink(&errors);
+	r = tprintf(&context, &out, "%v", (size_t) 0, (const int *) NULL, (const char *) NULL);
+	check(r < 0, "%v at the end of the format didn't fail");
+	check(errors.buf.len > 0 && !memchr(errors.buf.data, 0, errors.buf.len),
+	      "%v at the end of the format put a NUL in the error message");
+	write_sink(&errors, 1, "");
+	check(strstr(errors.buf.data, "missing element conversion") != NULL,
+	      "%v at the end of the format wasn't reported as missing its element");
+
+	free(errors.buf.data);
+	free(sink.buf.data);
+}
+
+int main(void)
+{
+	tprintf__init();
+
+	test_table();
+	test_table_overflow();
+	test_tee();
+	test_error();
+
+	printf("%d tests, %d passed\n", tests, passed);
+	return tests != passed;
+}
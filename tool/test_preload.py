@@ -0,0 +1,132 @@
+"""
+Test the preload library against libc. Run under LD_PRELOAD, snprintf is
+tprintf's and libc_snprintf is libc's own; the calls generated include some
+that the library has to pass through to libc.
+"""
+
+import random
+
+import test
+from test import tpf, ffi
+
+def gen_float(r):
+    f = r.choice(('%f', '%.3e', '%g', '%10.2f', '%-+8.1a'))
+    return f, [ffi.cast('double', r.uniform(-1e6, 1e6))]
+
+def gen_star(r):
+    f = r.choice(('%*d', '%-*x', '%.*d', '%*.*u'))
+    a = [ffi.cast('int', r.randint(-10, 10)) for i in range(f.count('*'))]
+    return f, a + [ffi.cast('int', r.randint(-1000, 1000))]
+
+def gen_other(r):
+    return r.choice((
+        ('%p', [ffi.cast('void *', r.randint(0, 2 ** 32))]),
+        ('%zd', [ffi.cast('size_t', r.randint(0, 2 ** 32))]),
+        ('%5%', []),
+        ('%c', [ffi.cast('int', r.randint(0, 127))]),
+        ('%.3s', [ffi.NULL]),
+        ('%s', [ffi.NULL]),
+    ))
+
+def gen_flags(r):
+    """Flags given more than once, as many as 30 times over."""
+    f = '%' + ''.join(r.choice(' +-0') * r.randint(1, 30) for i in range(r.randint(1, 3)))
+    return f + str(r.randint(0, 9)) + 'd|', [ffi.cast('int', r.randint(-1000, 1000))]
+
+def gen_wide(r):
+    """Wide enough that fprintf has to stage the call off the stack."""
+    return '%*s', [ffi.cast('int', r.randint(100, 1500)), ffi.new('char[]', b'wide')]
+
+def gen_arg(r):
+    return r.choice((test.gen_int, test.gen_unsigned, test.gen_str,
+                     gen_float, gen_star, gen_other, gen_flags, gen_wide))(r)
+
+def gen_call(r):
+    fmt = ""
+    args = []
+    for i in range(r.randint(1, 5)):
+        f, a = gen_arg(r)
+        fmt += f
+        args.extend(a)
+    return [ffi.new('char[]', fmt.encode())] + args
+
+def call_snprintf(f, a, buf):
+    n = f(buf, ffi.sizeof(buf), *a)
+    return n, ffi.buffer(buf, min(n + 1, ffi.sizeof(buf)))[:] if n >= 0 else b''
+
+def call_fprintf(f, a, buf):
+    """Into a fresh tmpfile, read back afterwards."""
+    fp = tpf.tmpfile()
+    n = f(fp, *a)
+    size = tpf.ftell(fp)
+    tpf.rewind(fp)
+    got = ffi.buffer(buf, tpf.fread(buf, 1, size, fp))[:]
+    tpf.fclose(fp)
+    return n, got
+
+def call_asprintf(f, a, buf):
+    strp = ffi.new('char **')
+    n = f(strp, *a)
+    if n < 0:
+        return n, b''
+    got = ffi.buffer(strp[0], n + 1)[:]
+    tpf.free(strp[0])
+    return n, got
+
+CALLS = (
+    ('snprintf', call_snprintf, lambda: tpf.libc_snprintf, lambda: tpf.snprintf),
+    ('fprintf',  call_fprintf,  lambda: tpf.libc_fprintf,  lambda: tpf.fprintf),
+    ('asprintf', call_asprintf, lambda: tpf.libc_asprintf, lambda: tpf.asprintf),
+)
+
+def test_one(i, r, buf1, buf2):
+    a = gen_call(r)
+    name, call, libc, preload = r.choice(CALLS)
+    n1, s1 = call(libc(), a, buf1)
+    n2, s2 = call(preload(), a, buf2)
+    if n1 != n2 or s1 != s2:
+        print("XXX FAIL: test {} ({})".format(i, name))
+        print("XXX input: {!r}".format(a))
+        print("XXX libc    printed: {!r} ({})".format(s1, n1))
+        print("XXX preload printed: {!r} ({})".format(s2, n2))
+        return False
+    return True
+
+def test_unwritable():
+    """A stream that takes nothing fails the call, as it does for libc."""
+    fp = tpf.fopen(b'/dev/null', b'r')
+    a = [ffi.new('char[]', b'%d|'), ffi.cast('int', 1)]
+    n1, n2 = tpf.libc_fprintf(fp, *a), tpf.fprintf(fp, *a)
+    tpf.fclose(fp)
+    if n1 != -1 or n2 != -1:
+        print("XXX fprintf to a read-only stream returned {}, libc {}".format(n2, n1))
+        return False
+    return True
+
+def main(n='10000'):
+    counts = ffi.new('unsigned long[2]')
+    if tpf.preload_stats(counts, counts + 1) != 0:
+        print("XXX not running with the preload library, use `make preload`.")
+        return
+
+    r = random.Random()
+    # room for five of gen_wide's
+    buf1 = ffi.new("char[]", 10000)
+    buf2 = ffi.new("char[]", 10000)
+    ok = 0
+    for i in range(int(n)):
+        if test_one(i, r, buf1, buf2):
+            ok += 1
+    n = int(n) + 1
+    if test_unwritable():
+        ok += 1
+
+    tpf.preload_stats(counts, counts + 1)
+    tpf.fflush(tpf.stdout)
+    print("{} tests, {} passed ({} calls by tprintf, {} by libc)"
+          .format(n, ok, counts[0], counts[1]))
+
+
+if tpf is not None and __name__ == '__main__':
+    import sys
+    main(*sys.argv[1:])
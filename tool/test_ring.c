@@ -0,0 +1,228 @@
+/*
+ * Check the ring against producers and a reader running at once, and check
+ * that recovery gets past records whose writers died.
+ *
+ *   test_ring [-t threads] [-n records per thread]
+ *
+ * Output follows tool/test.py: XXX lines for failures, then a summary.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tprintf.h>
+#include <tring.h>
+#include <tstd.h>
+#include <tstdio.h>
+
+/* Where tring.c keeps head and tail in the file, for faking dead writers. */
+#define HEAD_OFFSET 64
+#define TAIL_OFFSET 128
+
+struct producer {
+	pthread_t thread;
+	int id;
+	long records;
+};
+
+struct check {
+	long *next;
+	int threads;
+	long received, bad;
+};
+
+static struct tpf_ring ring;
+static int tests, passed;
+
+static void *produce(void *arg)
+{
+	struct producer *p = arg;
+	struct tpf_output out = tpf_output_ring(&ring);
+	long i;
+
+	for (i = 0; i < p->records; i++)
+		tprintf(tprintf__context, &out, "t%d n%ld", p->id, i);
+	return NULL;
+}
+
+/* Each record must be whole, and come after the last one from its thread. */
+static size_t write_check(void *arg, size_t len, const char *data)
+{
+	struct check *c = arg;
+	char buf[64];
+	long n;
+	int t, end;
+
+	c->received++;
+	if (len >= sizeof buf)
+		goto bad;
+	memcpy(buf, data, len);
+	buf[len] = 0;
+
+	end = -1;
+	if (sscanf(buf, "t%d n%ld%n", &t, &n, &end) != 2 || end != (int) len)
+		goto bad;
+	if (t < 0 || t >= c->threads || n < c->next[t])
+		goto bad;
+	c->next[t] = n + 1;
+	return len;
+
+bad:
+	if (c->bad++ < 10)
+		printf("XXX bad record %.*s\n", (int) len, data);
+	return len;
+}
+
+static void expect(int ok, const char *what)
+{
+	tests++;
+	if (ok)
+		passed++;
+	else
+		printf("XXX %s\n", what);
+}
+
+static void concurrent(const char *path, int threads, long records)
+{
+	struct producer *p = calloc(threads, sizeof *p);
+	struct check c = { calloc(threads, sizeof *c.next), threads };
+	struct tpf_output out = { write_check, &c };
+	long total = (long) threads * records;
+	int i;
+
+	if (!p || !c.next) {
+		perror("calloc");
+		exit(1);
+	}
+
+	/* Small enough that the producers overrun it and records get dropped. */
+	unlink(path);
+	if (tpf_ring_open(&ring, path, 1) != 0) {
+		perror(path);
+		exit(1);
+	}
+
+	for (i = 0; i < threads; i++) {
+		p[i].id = i;
+		p[i].records = records;
+		if ((errno = pthread_create(&p[i].thread, NULL, produce, &p[i])) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	while (c.received + (long) tpf_ring_dropped(&ring) < total)
+		tpf_ring_drain(&ring, &out, 0);
+
+	for (i = 0; i < threads; i++)
+		pthread_join(p[i].thread, NULL);
+	tpf_ring_drain(&ring, &out, 0);
+
+	expect(c.bad == 0, "records came out mangled or out of order");
+	expect(c.received + (long) tpf_ring_dropped(&ring) == total, "records were lost without being counted as dropped");
+	expect(tpf_ring_truncated(&ring) == 0, "records were truncated");
+
+	tpf_ring_close(&ring);
+	unlink(path);
+	free(c.next);
+	free(p);
+}
+
+static size_t write_collect(void *arg, size_t len, const char *data)
+{
+	struct tpf_output *collect = arg;
+
+	collect->writer(collect->opaque, len, data);
+	collect->writer(collect->opaque, 1, ";");
+	return len;
+}
+
+static void record(const char *s)
+{
+	struct tpf_output out = tpf_output_ring(&ring);
+
+	tprintf(tprintf__context, &out, "%s", s);
+}
+
+/* Claims space at head the way a writer that died straight after would. */
+static void *claim(uint64_t len)
+{
+	uint64_t *head = (uint64_t *)((char *) ring.hdr + HEAD_OFFSET);
+	void *p = ring.data + (*head & (ring.size - 1));
+
+	*head += len;
+	return p;
+}
+
+static void recovery(const char *path)
+{
+	struct tpf_growbuf got = { NULL };
+	struct tpf_output collect = tpf_output_growbuf(&got);
+	struct tpf_output out = { write_collect, &collect };
+	uint64_t *word;
+
+	unlink(path);
+	if (tpf_ring_open(&ring, path, 1) != 0) {
+		perror(path);
+		exit(1);
+	}
+
+	record("first");
+	claim(24);
+	record("after a gap");
+	word = claim(16);
+	*word = (uint64_t) 1 << 32 | 5;
+	memcpy(word + 1, "unfin", 5);
+	record("after a stuck record");
+
+	got.len = 0;
+	tpf_ring_drain(&ring, &out, 0);
+	expect(got.len == 6 && memcmp(got.data, "first;", 6) == 0, "draining went past a record that was never written");
+
+	got.len = 0;
+	tpf_ring_drain(&ring, &out, 1);
+	expect(got.len == 33 && memcmp(got.data, "after a gap;after a stuck record;", 33) == 0, "recovery didn't get past dead writers' records");
+	expect(*(uint64_t *)((char *) ring.hdr + TAIL_OFFSET) == *(uint64_t *)((char *) ring.hdr + HEAD_OFFSET), "recovery didn't empty the ring");
+
+	tpf_ring_close(&ring);
+	unlink(path);
+	free(got.data);
+}
+
+int main(int argc, char **argv)
+{
+	char path[] = "/tmp/test_ring.XXXXXX";
+	int threads = 4, c, fd;
+	long records = 100000;
+
+	while ((c = getopt(argc, argv, "t:n:")) != -1) {
+		switch (c) {
+		case 't': threads = atoi(optarg); break;
+		case 'n': records = atol(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-t threads] [-n records per thread]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+	close(fd);
+
+	tprintf__init();
+	concurrent(path, threads, records);
+	recovery(path);
+
+	printf("%d tests, %d passed\n", tests, passed);
+	return tests != passed;
+}
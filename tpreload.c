@@ -0,0 +1,448 @@
+/*
+ * The printf family, on top of tvprintf(), for LD_PRELOAD or linking ahead of
+ * libc. Formats using anything tprintf doesn't do exactly as libc does (floating
+ * point, %p, wide characters, positional arguments, ...) are handed to libc.
+ *
+ * With TPRINTF_PRELOAD_STATS set in the environment, the number of calls that
+ * went each way is printed to stderr at exit.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tprintf.h"
+#include "tstd.h"
+#include "tstdio.h"
+
+enum { PATH_TPRINTF, PATH_LIBC };
+
+static unsigned long calls[2];
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static int (*libc_vfprintf) (FILE *, const char *, va_list);
+static int (*libc_vsnprintf)(char *, size_t, const char *, va_list);
+static int (*libc_vsprintf) (char *, const char *, va_list);
+static int (*libc_vasprintf)(char **, const char *, va_list);
+
+static void init(void)
+{
+	tprintf__init();
+
+	libc_vfprintf  = (int (*)(FILE *, const char *, va_list))  dlsym(RTLD_NEXT, "vfprintf");
+	libc_vsnprintf = (int (*)(char *, size_t, const char *, va_list)) dlsym(RTLD_NEXT, "vsnprintf");
+	libc_vsprintf  = (int (*)(char *, const char *, va_list))  dlsym(RTLD_NEXT, "vsprintf");
+	libc_vasprintf = (int (*)(char **, const char *, va_list)) dlsym(RTLD_NEXT, "vasprintf");
+}
+
+/* Conversions, and the flags they take, that come out the same as libc's. */
+static const char *conv_flags(char c)
+{
+	switch (c) {
+	case 'd': case 'i': case 'u':
+		return " +-0";
+	case 'o': case 'x': case 'X':
+		return " +-0#";
+	case 'c': case 's':
+		return " +-";
+	case 'n':
+		return "";
+	}
+	return NULL;
+}
+
+/*
+ * Walks the format, and a copy of the arguments: tprintf refuses negative '*'
+ * widths and precisions, where libc takes them as '-' and no precision.
+ */
+static int supported(const char *p, va_list ap)
+{
+	const char *allow;
+	const char *flags;
+	char length;
+
+	while ((p = strchr(p, '%'))) {
+		p++;
+		if (*p == '%') {
+			p++;
+			continue;
+		}
+
+		/* Repeated flags go to libc, which also keeps under readflags()'s 15. */
+		flags = p;
+		while (*p && strchr(" +-0#", *p)) {
+			if (memchr(flags, *p, p - flags))
+				return 0;
+			p++;
+		}
+
+		if (*p == '*') {
+			if (va_arg(ap, int) < 0)
+				return 0;
+			p++;
+		} else {
+			while (*p >= '0' && *p <= '9')
+				p++;
+			if (*p == '$')
+				return 0;
+		}
+
+		if (*p == '.') {
+			p++;
+			if (*p == '*') {
+				if (va_arg(ap, int) < 0)
+					return 0;
+				p++;
+			} else {
+				while (*p >= '0' && *p <= '9')
+					p++;
+			}
+		}
+
+		length = 0;
+		switch (*p) {
+		case 'h': case 'l':
+			length = *p;
+			if (p[1] == *p) {
+				length = *p == 'h' ? 'H' : 'L';
+				p++;
+			}
+			p++;
+			break;
+		case 'j': case 'z': case 't':
+			length = *p++;
+		}
+
+		allow = conv_flags(*p);
+		if (!allow)
+			return 0;
+		for ( ; flags < p && strchr(" +-0#", *flags); flags++)
+			if (!strchr(allow, *flags))
+				return 0;
+
+		if (*p == 'c' || *p == 's' || *p == 'n') {
+			if (length)
+				return 0;
+			if (*p == 'c')
+				(void) va_arg(ap, int);
+			else
+				(void) va_arg(ap, void *);
+			p++;
+			continue;
+		}
+
+		/* tprintf has no signed size_t or unsigned ptrdiff_t */
+		if (length == 'z' && (*p == 'd' || *p == 'i'))
+			return 0;
+		if (length == 't' && !(*p == 'd' || *p == 'i'))
+			return 0;
+
+		switch (length) {
+		case 'l': (void) va_arg(ap, long);      break;
+		case 'L': (void) va_arg(ap, long long); break;
+		case 'j': (void) va_arg(ap, intmax_t);  break;
+		case 'z': (void) va_arg(ap, size_t);    break;
+		case 't': (void) va_arg(ap, ptrdiff_t); break;
+		default:  (void) va_arg(ap, int);
+		}
+
+		p++;
+	}
+
+	return 1;
+}
+
+static int fast(const char *fmt, va_list ap)
+{
+	va_list aq;
+	int path;
+
+	pthread_once(&once, init);
+
+	va_copy(aq, ap);
+	path = supported(fmt, aq) ? PATH_TPRINTF : PATH_LIBC;
+	va_end(aq);
+
+	__atomic_fetch_add(&calls[path], 1, __ATOMIC_RELAXED);
+
+	return path == PATH_TPRINTF;
+}
+
+static int format_buffer(char *str, size_t n, const char *fmt, va_list ap)
+{
+	struct tpf_buffer buffer = { str, 0, n };
+	struct tpf_output out = tpf_output_buffer(&buffer);
+	int r;
+
+	r = tvprintf(tprintf__context, &out, fmt, ap);
+	if (str != NULL && n > 0)
+		str[buffer.pos] = 0;
+
+	return r;
+}
+
+/*
+ * A call to a FILE is staged whole and handed over in one fwrite, as libc
+ * does it: on an unbuffered stream that's one write(2), so lines from processes
+ * sharing it don't interleave. Most calls fit on the stack; longer ones move to
+ * a growbuf.
+ */
+struct file_sink {
+	char buf[512];
+	size_t len;
+	struct tpf_growbuf spill;
+};
+
+static size_t write_stage(void *arg, size_t len, const char *data)
+{
+	struct file_sink *sink = arg;
+	struct tpf_output out = tpf_output_growbuf(&sink->spill);
+
+	if (!sink->spill.data) {
+		if (len <= sizeof sink->buf - sink->len) {
+			memcpy(sink->buf + sink->len, data, len);
+			sink->len += len;
+			return len;
+		}
+		if (out.writer(out.opaque, sink->len, sink->buf) < sink->len)
+			return 0;
+	}
+
+	return out.writer(out.opaque, len, data);
+}
+
+void tprintf_preload_stats(unsigned long *tprintf, unsigned long *libc)
+{
+	*tprintf = __atomic_load_n(&calls[PATH_TPRINTF], __ATOMIC_RELAXED);
+	*libc    = __atomic_load_n(&calls[PATH_LIBC],    __ATOMIC_RELAXED);
+}
+
+__attribute__((destructor))
+static void report(void)
+{
+	struct tpf_output out = tpf_output_FILE(stderr);
+
+	if (!getenv("TPRINTF_PRELOAD_STATS"))
+		return;
+
+	pthread_once(&once, init);
+	tprintf(tprintf__context, &out, "tprintf: %lu calls formatted by tprintf, %lu passed to libc\n",
+	        calls[PATH_TPRINTF], calls[PATH_LIBC]);
+}
+
+int vfprintf(FILE *f, const char *fmt, va_list ap)
+{
+	struct file_sink sink;
+	struct tpf_output out = { write_stage, &sink };
+	const char *data;
+	size_t len;
+	int r;
+
+	if (!fast(fmt, ap))
+		return libc_vfprintf(f, fmt, ap);
+
+	sink.len = 0;
+	sink.spill = (struct tpf_growbuf) { 0 };
+
+	r = tvprintf(tprintf__context, &out, fmt, ap);
+	if (sink.spill.failed)
+		r = -1;
+
+	if (r >= 0) {
+		data = sink.spill.data ? sink.spill.data : sink.buf;
+		len  = sink.spill.data ? sink.spill.len  : sink.len;
+
+		flockfile(f);
+		if (fwrite(data, 1, len, f) < len)
+			r = -1;
+		funlockfile(f);
+	}
+
+	free(sink.spill.data);
+	return r;
+}
+
+int vprintf(const char *fmt, va_list ap)
+{
+	return vfprintf(stdout, fmt, ap);
+}
+
+int vsnprintf(char *str, size_t n, const char *fmt, va_list ap)
+{
+	if (!fast(fmt, ap))
+		return libc_vsnprintf(str, n, fmt, ap);
+
+	return format_buffer(str, n, fmt, ap);
+}
+
+int vsprintf(char *str, const char *fmt, va_list ap)
+{
+	if (!fast(fmt, ap))
+		return libc_vsprintf(str, fmt, ap);
+
+	return format_buffer(str, SIZE_MAX, fmt, ap);
+}
+
+int vasprintf(char **strp, const char *fmt, va_list ap)
+{
+	struct tpf_growbuf g = { 0 };
+	struct tpf_output out = tpf_output_growbuf(&g);
+	int r;
+
+	if (!fast(fmt, ap))
+		return libc_vasprintf(strp, fmt, ap);
+
+	r = tvprintf(tprintf__context, &out, fmt, ap);
+	if (r >= 0)
+		out.writer(out.opaque, 1, "");
+	if (r < 0 || g.failed) {
+		free(g.data);
+		return -1;
+	}
+
+	*strp = g.data;
+	return r;
+}
+
+int printf(const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = vfprintf(stdout, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int fprintf(FILE *f, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = vfprintf(f, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int snprintf(char *str, size_t n, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = vsnprintf(str, n, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int sprintf(char *str, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = vsprintf(str, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int asprintf(char **strp, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = vasprintf(strp, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+/*
+ * Callers built with _FORTIFY_SOURCE use these instead. The flag only matters
+ * for %n in writable formats, which we don't try to police.
+ */
+
+int __vfprintf_chk(FILE *f, int flag, const char *fmt, va_list ap)
+{
+	return vfprintf(f, fmt, ap);
+}
+
+int __vprintf_chk(int flag, const char *fmt, va_list ap)
+{
+	return vfprintf(stdout, fmt, ap);
+}
+
+int __vsnprintf_chk(char *str, size_t n, int flag, size_t size, const char *fmt, va_list ap)
+{
+	if (n > size)
+		abort();
+	return vsnprintf(str, n, fmt, ap);
+}
+
+int __vsprintf_chk(char *str, int flag, size_t size, const char *fmt, va_list ap)
+{
+	int r = vsnprintf(str, size, fmt, ap);
+	if (r >= 0 && (size_t) r >= size)
+		abort();
+	return r;
+}
+
+int __vasprintf_chk(char **strp, int flag, const char *fmt, va_list ap)
+{
+	return vasprintf(strp, fmt, ap);
+}
+
+int __printf_chk(int flag, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = vfprintf(stdout, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int __fprintf_chk(FILE *f, int flag, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = vfprintf(f, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int __snprintf_chk(char *str, size_t n, int flag, size_t size, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = __vsnprintf_chk(str, n, flag, size, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int __sprintf_chk(char *str, int flag, size_t size, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = __vsprintf_chk(str, flag, size, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int __asprintf_chk(char **strp, int flag, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = vasprintf(strp, fmt, ap);
+	va_end(ap);
+	return r;
+}
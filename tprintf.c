@@ -1,4 +1,3 @@
-#include <ctype.h>
 #include <errno.h>
 #include <limits.h>
 #include <stdarg.h>
@@ -40,7 +39,7 @@ int tpf_register(struct tpf_context *context, char letter, const char *flags, in
 	if (len >= sizeof fmt->flags)
 		return -1;
 
-	memcpy(fmt->flags, flags, len);
+	memcpy(fmt->flags, flags, len + 1);
 	qsort(fmt->flags, len, 1, cmp_char);
 
 	context->fmts[(unsigned char)letter] = fmt;
@@ -71,6 +70,12 @@ static size_t tpout(const struct tpf_output *out, size_t len, const char *data)
 	return out->writer(out->opaque, len, data);
 }
 
+static void tpend(const struct tpf_output *out, int result)
+{
+	if (out->end)
+		out->end(out->opaque, result);
+}
+
 void tpf_write(struct tpf_state *state, size_t len, const char *data)
 {
 	size_t r;
@@ -87,37 +92,27 @@ void tpf_write(struct tpf_state *state, size_t len, const char *data)
 void tpf_error(struct tpf_state *state, const char *fmt, ...)
 {
 	const char *fp = state->format;
-	ptrdiff_t ep = state->fpos - state->format;
-	struct tpf_output *out = state->context->error;
+	struct tpf_output *error = state->context->error;
+	struct tpf_output quiet, *out = &quiet;
 	struct tpf_context ctx;
 	va_list ap;
+	int ep;
 
-	if (!out)
+	if (!error)
 		abort();
 
+	/* The message is one call as far as the end hook goes, however it's made. */
+	quiet = *error;
+	quiet.end = NULL;
+
 	ctx = *tprintf__context;
 	ctx.error = 0;
 
 	tpout(out, 7, "ERROR:\n");
 
-	tpout(out, 3, "  \"");
-	while (*fp) {
-		switch (*fp) {
-		case '\"': tpout(out, 2, "\\\""); if (fp < state->fpos) ep++; break;
-		case '\n': tpout(out, 2, "\\n");  if (fp < state->fpos) ep++; break;
-		case '\t': tpout(out, 2, "\\t");  if (fp < state->fpos) ep++; break;
-		default:
-			if (isprint((unsigned char)*fp)) {
-				tpout(out, 1, fp);
-			} else {
-				/* 3 characters of octal is guaranteed not to eat anything following */
-				size_t n = tprintf(&ctx, out, "\\%03hho", *fp);
-				if (fp < state->fpos) ep += n - 1;
-			}
-		}
-		fp++;
-	}
-	tpout(out, 2, "\"\n");
+	/* The format with %q's escaping, split where the caret has to go under it. */
+	ep = tprintf(&ctx, out, "  \"%.*q", (int)(state->fpos - fp), fp) - 3;
+	tprintf(&ctx, out, "%q\"\n", state->fpos);
 
 	tprintf(&ctx, out, "   %*s^\n", ep, "");
 
@@ -128,12 +123,20 @@ void tpf_error(struct tpf_state *state, const char *fmt, ...)
 	va_end(ap);
 
 	tpout(out, 1, "\n");
+	tpend(error, 0);
 }
 
-static void repeat(struct tpf_state *state, char c, size_t n)
+/* Writes n copies of c, 32 at a time. */
+void tpf_repeat(struct tpf_state *state, char c, size_t n)
 {
-	for ( ; n; n--)
-		tpf_write(state, 1, &c);
+	char buf[32];
+	size_t len;
+
+	memset(buf, c, n < sizeof buf ? n : sizeof buf);
+	for ( ; n && !state->error; n -= len) {
+		len = n < sizeof buf ? n : sizeof buf;
+		tpf_write(state, len, buf);
+	}
 }
 
 void tpf_pad(struct tpf_state *state, size_t ow)
@@ -147,7 +150,7 @@ void tpf_pad(struct tpf_state *state, size_t ow)
 	pad = state->fw - ow;
 
 	if (just == RIGHT)
-		repeat(state, ' ', pad);
+		tpf_repeat(state, ' ', pad);
 	else
 		state->padding = pad;
 }
@@ -168,8 +171,7 @@ static const char *readflags(struct tpf_state *state, const char *p)
 	if (len > 15)
 		len = 15;
 	state->flags[len] = '\0';
-	if (q != p)
-		memcpy(state->flags, p, q - p);
+	memcpy(state->flags, p, len);
 	qsort(state->flags, len, 1, cmp_char);
 
 	return q;
@@ -276,6 +278,12 @@ static const char *readlen(struct tpf_state *state, const char *p)
 	case 'z': state->length = LENGTH_z;     return p + 1;
 	case 't': state->length = LENGTH_t;     return p + 1;
 	case 'L': state->length = LENGTH_L;     return p + 1;
+	case 'w':
+		if (strncmp(p, "w128", 4) == 0) {
+			state->length = LENGTH_w128;
+			return p + 4;
+		}
+		/* fall through */
 	default:  state->length = LENGTH_UNSET; return p;
 	}
 
@@ -311,7 +319,38 @@ static void rinse(struct tpf_state * state) {
 	state->padding = 0;
 }
 
-int tvprintf(const struct tpf_context *context, const struct tpf_output *output, const char *fmt, va_list ap)
+/*
+ * Does one conversion, with the flags, width, precision and length already in
+ * state; this is all of tvprintf() past parsing.
+ */
+static int convert(struct tpf_state *state, char spec, va_list *ap)
+{
+	const struct tpf_format *formatter = state->context->fmts[(unsigned char)spec];
+	char c;
+
+	if (!formatter) {
+		tpf_error(state, "'%c': no formatter known for conversion", spec);
+		return -1;
+	}
+	if (c = checkflags(formatter->flags, state->flags)) {
+		tpf_error(state, "'%c': invalid flag for conversion '%c'", c, spec);
+		return -1;
+	}
+
+	state->formatter = formatter;
+
+	if (formatter->callback(state, ap) != 0)
+		return -1;
+
+	state->formatter = 0;
+
+	tpf_repeat(state, ' ', state->padding);
+
+	rinse(state);
+	return 0;
+}
+
+static int interpret(const struct tpf_context *context, const struct tpf_output *output, const char *fmt, va_list ap)
 {
 	const char *p;
 	struct tpf_state state = {.context = context};
@@ -321,13 +360,11 @@ int tvprintf(const struct tpf_context *context, const struct tpf_output *output,
 	state.output = output;
 	va_copy(hack, ap);
 
-	for (p = fmt; *p; p++) {
+	/* Once the output has stopped taking anything, don't bother going on. */
+	for (p = fmt; *p && !state.error; p++) {
 		if (*p != '%') {
 			tpf_write(&state, 1, p);
 		} else {
-			const struct tpf_format *formatter;
-			char c;
-
 			state.fpos = p;
 
 			p++;
@@ -340,26 +377,10 @@ int tvprintf(const struct tpf_context *context, const struct tpf_output *output,
 			if (!p)
 				goto fail;
 
-			formatter = context->fmts[(unsigned char)*p];
-			if (!formatter) {
-				tpf_error(&state, "'%c': no formatter known for conversion", *p);
+			state.fconv = p;
+			if (convert(&state, *p, &hack) != 0)
 				goto fail;
-			}
-			if (c = checkflags(formatter->flags, state.flags)) {
-				tpf_error(&state, "'%c': invalid flag for conversion '%c'", c, *p);
-				goto fail;
-			}
-
-			state.formatter = formatter;
-
-			if (formatter->callback(&state, &hack) != 0)
-				goto fail;
-
-			state.formatter = 0;
-
-			repeat(&state, ' ', state.padding);
-
-			rinse(&state);
+			p = state.fconv;
 		}
 	}
 
@@ -372,6 +393,36 @@ fail:
 	return -1;
 }
 
+static int cmp_special(const void *key, const void *elem)
+{
+	const struct tpf_special *special = elem;
+	return strcmp(key, special->format);
+}
+
+/* The table must stay around, sorted by format as strcmp() orders them. */
+void tpf_specialize(struct tpf_context *context, const struct tpf_special *special, size_t n)
+{
+	context->special = special;
+	context->nspecial = n;
+}
+
+int tvprintf(const struct tpf_context *context, const struct tpf_output *output, const char *fmt, va_list ap)
+{
+	const struct tpf_special *special = NULL;
+	int r;
+
+	if (context->nspecial)
+		special = bsearch(fmt, context->special, context->nspecial, sizeof *special, cmp_special);
+
+	if (special)
+		r = special->fn(context, output, ap);
+	else
+		r = interpret(context, output, fmt, ap);
+
+	tpend(output, r);
+	return r;
+}
+
 int tprintf(const struct tpf_context *context, const struct tpf_output *output, const char *fmt, ...)
 {
 	int r;
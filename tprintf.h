@@ -13,9 +13,15 @@ struct tpf_format {
 	int (*callback)(struct tpf_state *, va_list *);
 };
 
+struct tpf_special;
+
 struct tpf_context {
 	struct tpf_format *fmts[UCHAR_MAX + 1];
 	struct tpf_output *error;
+
+	/* sorted by format; see tpf_specialize() */
+	const struct tpf_special *special;
+	size_t nspecial;
 };
 
 struct tpf_state {
@@ -26,6 +32,8 @@ struct tpf_state {
 
 	const struct tpf_format *formatter;
 	const char *format, *fpos;
+	/* the conversion character; a converter that reads more of the format moves it on */
+	const char *fconv;
 
 	char flags[16];
 	enum {
@@ -37,6 +45,7 @@ struct tpf_state {
 		LENGTH_j,
 		LENGTH_z,
 		LENGTH_t,
+		LENGTH_w128,
 		LENGTH_UNSET
 	} length;
 	size_t fw,     prec;
@@ -48,6 +57,17 @@ struct tpf_state {
 struct tpf_output {
 	size_t (*writer)(void *, size_t, const char *);
 	void *opaque;
+	/* optional; called at the end of each tvprintf() with its result */
+	void (*end)(void *, int);
+};
+
+/*
+ * A format compiled ahead of time (by tool/specialize.py): fn does what
+ * tvprintf() would with that format, without parsing it, and returns the same.
+ */
+struct tpf_special {
+	const char *format;
+	int (*fn)(const struct tpf_context *, const struct tpf_output *, va_list);
 };
 
 int tvprintf (const struct tpf_context *, const struct tpf_output *, const char *, va_list);
@@ -58,8 +78,11 @@ int  tpf_register  (struct tpf_context *, char, const char *, int (*)(struct tpf
 void tpf_unregister(struct tpf_context *, char);
 void tpf_fini      (struct tpf_context *);
 
-void tpf_error(struct tpf_state *, const char *, ...);
-void tpf_write(struct tpf_state *, size_t, const char *);
-void tpf_pad  (struct tpf_state *, size_t);
+void tpf_specialize(struct tpf_context *, const struct tpf_special *, size_t);
+
+void tpf_error (struct tpf_state *, const char *, ...);
+void tpf_write (struct tpf_state *, size_t, const char *);
+void tpf_pad   (struct tpf_state *, size_t);
+void tpf_repeat(struct tpf_state *, char, size_t);
 
 #endif
@@ -0,0 +1,265 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tprintf.h"
+#include "tring.h"
+
+#if __STDC_VERSION__ >= 201112L
+#define THREAD_LOCAL _Thread_local
+#elif defined __GNUC__
+#define THREAD_LOCAL __thread
+#else
+#error "tring.c needs thread-local storage"
+#endif
+
+#define RING_MAGIC   0x54524e47 /* "TRNG" */
+#define RING_VERSION 1
+#define RING_PAGE    4096
+
+/* Each record starts with a word holding its state (high half) and length. */
+enum {
+	RECORD_FREE    = 0,
+	RECORD_WRITING = 1,
+	RECORD_DONE    = 2,
+	RECORD_PAD     = 3
+};
+
+#define WORD(state, len) ((uint64_t)(state) << 32 | (uint32_t)(len))
+#define ALIGN(n)         (((n) + 7) & ~(uint64_t)7)
+
+/* head and tail live on their own cache lines; producers only touch head. */
+struct tpf_ring_header {
+	uint32_t magic, version;
+	uint64_t size;
+	uint64_t dropped, truncated;
+	char pad0[32];
+	uint64_t head;
+	char pad1[56];
+	uint64_t tail;
+	char pad2[56];
+};
+
+struct stage {
+	size_t len;
+	int truncated;
+	char buf[TPF_RING_RECORD_MAX];
+};
+
+static THREAD_LOCAL struct stage stage;
+
+#define LOAD(p, order)     __atomic_load_n(p, __ATOMIC_ ## order)
+#define STORE(p, v, order) __atomic_store_n(p, v, __ATOMIC_ ## order)
+
+int tpf_ring_open(struct tpf_ring *ring, const char *path, size_t size)
+{
+	struct tpf_ring_header *hdr;
+	struct stat st;
+	size_t maplen;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDWR | (size ? O_CREAT : 0), 0644);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0)
+		goto fail;
+
+	if (st.st_size == 0) {
+		size_t n = 16 * RING_PAGE;
+
+		if (!size)
+			goto fail;
+		while (n < size)
+			n *= 2;
+
+		maplen = RING_PAGE + n;
+		if (ftruncate(fd, maplen) != 0)
+			goto fail;
+	} else {
+		maplen = st.st_size;
+	}
+
+	map = mmap(NULL, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		goto fail;
+	close(fd);
+
+	hdr = map;
+	if (st.st_size == 0) {
+		hdr->version = RING_VERSION;
+		hdr->size = maplen - RING_PAGE;
+		STORE(&hdr->magic, RING_MAGIC, RELEASE);
+	} else if (LOAD(&hdr->magic, ACQUIRE) != RING_MAGIC || hdr->version != RING_VERSION || hdr->size != maplen - RING_PAGE) {
+		munmap(map, maplen);
+		return -1;
+	}
+
+	ring->hdr = hdr;
+	ring->data = (char *) map + RING_PAGE;
+	ring->size = hdr->size;
+	ring->maplen = maplen;
+	return 0;
+
+fail:
+	close(fd);
+	return -1;
+}
+
+void tpf_ring_close(struct tpf_ring *ring)
+{
+	munmap(ring->hdr, ring->maplen);
+	ring->hdr = NULL;
+	ring->data = NULL;
+}
+
+static int reserve(struct tpf_ring *ring, uint64_t need, uint64_t *pos, uint64_t *pad)
+{
+	struct tpf_ring_header *hdr = ring->hdr;
+	uint64_t head = LOAD(&hdr->head, RELAXED), tail, off;
+
+	do {
+		off = head & (ring->size - 1);
+		*pad = off + need > ring->size ? ring->size - off : 0;
+		tail = LOAD(&hdr->tail, ACQUIRE);
+
+		if (head + *pad + need - tail > ring->size)
+			return -1;
+	} while (!__atomic_compare_exchange_n(&hdr->head, &head, head + *pad + need, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	*pos = head;
+	return 0;
+}
+
+static void commit(struct tpf_ring *ring, const char *data, size_t len)
+{
+	struct tpf_ring_header *hdr = ring->hdr;
+	uint64_t need = 8 + ALIGN(len), pos, pad;
+	uint64_t *word;
+
+	if (reserve(ring, need, &pos, &pad) != 0) {
+		__atomic_fetch_add(&hdr->dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	/* Records don't wrap; the tail end of the ring is skipped instead. */
+	if (pad) {
+		word = (uint64_t *)(ring->data + (pos & (ring->size - 1)));
+		STORE(word, WORD(RECORD_PAD, pad - 8), RELEASE);
+		pos += pad;
+	}
+
+	word = (uint64_t *)(ring->data + (pos & (ring->size - 1)));
+	STORE(word, WORD(RECORD_WRITING, len), RELAXED);
+	memcpy(word + 1, data, len);
+	STORE(word, WORD(RECORD_DONE, len), RELEASE);
+}
+
+static size_t write_ring(void *arg, size_t len, const char *data)
+{
+	size_t room = sizeof stage.buf - stage.len;
+
+	if (len > room) {
+		stage.truncated = 1;
+		len = room;
+	}
+
+	memcpy(stage.buf + stage.len, data, len);
+	stage.len += len;
+
+	return len;
+}
+
+static void end_ring(void *arg, int result)
+{
+	struct tpf_ring *ring = arg;
+
+	/* A call that failed part of the way through is not worth a record. */
+	if (result >= 0 && stage.len) {
+		if (stage.truncated)
+			__atomic_fetch_add(&ring->hdr->truncated, 1, __ATOMIC_RELAXED);
+		commit(ring, stage.buf, stage.len);
+	}
+
+	stage.len = 0;
+	stage.truncated = 0;
+}
+
+struct tpf_output tpf_output_ring(struct tpf_ring *ring)
+{
+	struct tpf_output output = { write_ring, ring, end_ring };
+	return output;
+}
+
+/*
+ * Hands every finished record to out, and returns how many there were. With
+ * recover set, records that were never finished (their writer having died) are
+ * skipped rather than waited for. That is only safe once nothing is writing to
+ * the ring any more: a live writer's record looks just the same.
+ */
+long tpf_ring_drain(struct tpf_ring *ring, const struct tpf_output *out, int recover)
+{
+	struct tpf_ring_header *hdr = ring->hdr;
+	uint64_t tail = LOAD(&hdr->tail, RELAXED);
+	uint64_t head = LOAD(&hdr->head, ACQUIRE);
+	long n = 0;
+
+	while (tail < head) {
+		char *p = ring->data + (tail & (ring->size - 1));
+		uint64_t word = LOAD((uint64_t *) p, ACQUIRE);
+		uint32_t len = (uint32_t) word;
+		uint64_t size = 8 + ALIGN(len);
+
+		switch (word >> 32) {
+		case RECORD_DONE:
+			out->writer(out->opaque, len, p + 8);
+			if (out->end)
+				out->end(out->opaque, len);
+			n++;
+			break;
+		case RECORD_PAD:
+			break;
+		case RECORD_WRITING:
+			if (recover)
+				break;
+			return n;
+		case RECORD_FREE:
+			/*
+			 * Reserved, but its writer died before saying how much.
+			 * Space is zeroed once drained, so the rest of it is too;
+			 * go a word at a time until the next record.
+			 */
+			if (recover) {
+				size = 8;
+				break;
+			}
+			/* fall through */
+		default:
+			return n;
+		}
+
+		/* Clear it so that nothing stale looks finished next time around. */
+		memset(p, 0, size);
+		tail += size;
+		STORE(&hdr->tail, tail, RELEASE);
+	}
+
+	return n;
+}
+
+uint64_t tpf_ring_dropped(const struct tpf_ring *ring)
+{
+	return LOAD(&ring->hdr->dropped, RELAXED);
+}
+
+uint64_t tpf_ring_truncated(const struct tpf_ring *ring)
+{
+	return LOAD(&ring->hdr->truncated, RELAXED);
+}
@@ -0,0 +1,40 @@
+#ifndef TPRINTF_TRING_H
+#define TPRINTF_TRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tprintf.h"
+
+#define TPF_RING_RECORD_MAX 4096
+
+struct tpf_ring_header;
+
+/*
+ * A ring is a file mapped shared into any number of processes. Every
+ * tvprintf() call through tpf_output_ring() becomes one record: it is staged
+ * per thread (up to TPF_RING_RECORD_MAX bytes, past which it is cut short) and
+ * copied into space reserved with a single compare-and-swap once the call
+ * ends. Producers never wait for the reader; when the ring is full the record
+ * is dropped and counted instead.
+ *
+ * There must only be one reader draining a ring at a time. Recovering the
+ * records of writers that died part of the way through is only for a ring
+ * nothing is writing to any more, as after a crash.
+ */
+struct tpf_ring {
+	struct tpf_ring_header *hdr;
+	char *data;
+	size_t size, maplen;
+};
+
+int  tpf_ring_open (struct tpf_ring *, const char *, size_t);
+void tpf_ring_close(struct tpf_ring *);
+
+struct tpf_output tpf_output_ring(struct tpf_ring *);
+
+long     tpf_ring_drain    (struct tpf_ring *, const struct tpf_output *, int);
+uint64_t tpf_ring_dropped  (const struct tpf_ring *);
+uint64_t tpf_ring_truncated(const struct tpf_ring *);
+
+#endif
@@ -1,39 +1,57 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <wchar.h>
 
+/* TPRINTF_SCALAR leaves the SIMD code out, so that what's left can be tested. */
+#if defined __SSE2__ && !defined TPRINTF_SCALAR
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "tprintf.h"
+#include "tstd.h"
+
+#if __STDC_VERSION__ >= 201112L
+#define THREAD_LOCAL _Thread_local
+#elif defined __GNUC__
+#define THREAD_LOCAL __thread
+#endif
 
 static struct tpf_context context;
 struct tpf_context *tprintf__context = &context;
 
-static void repeat(struct tpf_state *state, char c, unsigned n)
+static size_t cstrlen(const char *s, size_t limit)
 {
-	for ( ; n; n--)
-		tpf_write(state, 1, &c);
+	return strnlen(s, limit);
 }
 
-static size_t cstrlen(const char *s, size_t limit)
+static void convert_view(struct tpf_state *state, size_t len, const char *s)
 {
-	size_t len = 0;
-	for ( ; *s && len < limit; s++)
-		len++;
-	return len;
+	if (state->prec_set && (size_t) state->prec < len)
+		len = state->prec;
+
+	tpf_pad(state, len);
+	tpf_write(state, len, s);
 }
 
 static void convert_cstr(struct tpf_state *state, const char *s)
 {
 	size_t limit = state->prec_set ? (size_t) state->prec : SIZE_MAX;
-	size_t len = cstrlen(s, limit);
 
-	tpf_pad(state, len);
-	tpf_write(state, len, s);
+	convert_view(state, cstrlen(s, limit), s);
 }
 
-static size_t write_wstr(struct tpf_state *state, const wchar_t *wc, int dry_run)
+/*
+ * Writes (or with dry_run, measures) up to n wide characters, or up to a NUL if
+ * n is (size_t) -1, but never reads a character the precision has no room for.
+ */
+static size_t write_wstr(struct tpf_state *state, size_t n, const wchar_t *wc, int dry_run)
 {
 	char mbbuf[MB_CUR_MAX];
 	size_t bl;
@@ -41,27 +59,211 @@ static size_t write_wstr(struct tpf_state *state, const wchar_t *wc, int dry_run
 
 	mbstate_t mbstate = {0};
 
-	for ( ; *wc; wc++, pos++) {
+	for ( ; pos < n; wc++, pos++) {
+		if (state->prec_set && bytes >= (size_t) state->prec)
+			break;
+		if (n == (size_t) -1 && *wc == L'\0')
+			break;
 		bl = wcrtomb(mbbuf, *wc, &mbstate);
+		if (bl == (size_t) -1)
+			break;
 		if (state->prec_set && bytes + bl > (size_t) state->prec)
 			break;
-		if (!dry_run)
+		if (!dry_run) {
+			if (state->error)
+				break;
 			tpf_write(state, bl, mbbuf);
+		}
 		bytes += bl;
 	}
 
 	return pos;
 }
 
-static void convert_wstr(struct tpf_state *state, const wchar_t *wc)
+static void convert_wview(struct tpf_state *state, size_t n, const wchar_t *wc)
 {
-	size_t len = write_wstr(state, wc, 1);
+	size_t len = write_wstr(state, n, wc, 1);
 
 	tpf_pad(state, len);
-	write_wstr(state, wc, 0);
+	write_wstr(state, len, wc, 0);
+}
+
+static void convert_wstr(struct tpf_state *state, const wchar_t *wc)
+{
+	convert_wview(state, (size_t) -1, wc);
+}
+
+enum escape {
+	ESCAPE_JSON,
+	ESCAPE_CSV,       /* characters that force a CSV field to be quoted */
+	ESCAPE_CSV_QUOTE, /* characters that need escaping inside the quotes */
+	ESCAPE_C
+};
+
+static int is_special(enum escape mode, unsigned char c)
+{
+	switch (mode) {
+	case ESCAPE_JSON:      return c < 0x20 || c == '"' || c == '\\';
+	case ESCAPE_CSV:       return c == '"' || c == ',' || c == '\n' || c == '\r';
+	case ESCAPE_CSV_QUOTE: return c == '"';
+	case ESCAPE_C:         return c < 0x20 || c >= 0x7f || c == '"' || c == '\\';
+	}
+	return 0;
+}
+
+#ifdef USE_SSE2
+static __m128i special_mask(enum escape mode, __m128i x)
+{
+#define EQ(c) _mm_cmpeq_epi8(x, _mm_set1_epi8(c))
+	/* There are no unsigned byte comparisons, but min/max will do. */
+	__m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(0x1f)), x);
+
+	switch (mode) {
+	case ESCAPE_JSON:
+		return _mm_or_si128(ctrl, _mm_or_si128(EQ('"'), EQ('\\')));
+	case ESCAPE_CSV:
+		return _mm_or_si128(_mm_or_si128(EQ('"'), EQ(',')), _mm_or_si128(EQ('\n'), EQ('\r')));
+	case ESCAPE_CSV_QUOTE:
+		return EQ('"');
+	case ESCAPE_C:
+		ctrl = _mm_or_si128(ctrl, _mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8(0x7f)), x));
+		return _mm_or_si128(ctrl, _mm_or_si128(EQ('"'), EQ('\\')));
+	}
+	return _mm_setzero_si128();
+#undef EQ
 }
+#endif
 
-static int read_int(struct tpf_state *state, va_list *ap, intmax_t *v)
+/* Returns the offset of the first special character in s, or len. */
+static size_t scan_special(enum escape mode, const char *s, size_t len)
+{
+	size_t i = 0;
+
+#ifdef USE_SSE2
+	for ( ; i + 16 <= len; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+		int m = _mm_movemask_epi8(special_mask(mode, x));
+		if (m)
+			return i + __builtin_ctz(m);
+	}
+#endif
+
+	for ( ; i < len; i++)
+		if (is_special(mode, s[i]))
+			break;
+
+	return i;
+}
+
+static size_t escape_char(enum escape mode, unsigned char c, char *out)
+{
+	static const char simple[] = "\"\"\\\\\bb\ff\nn\rr\tt\aa\vv";
+	const char *p;
+
+	if (mode == ESCAPE_CSV_QUOTE) {
+		out[0] = out[1] = '"';
+		return 2;
+	}
+
+	out[0] = '\\';
+
+	for (p = simple; *p; p += 2) {
+		/* JSON has no \a or \v */
+		if (mode == ESCAPE_JSON && (p[0] == '\a' || p[0] == '\v'))
+			continue;
+		if (p[0] == c) {
+			out[1] = p[1];
+			return 2;
+		}
+	}
+
+	if (mode == ESCAPE_JSON) {
+		out[1] = 'u';
+		out[2] = out[3] = '0';
+		out[4] = "0123456789abcdef"[c >> 4];
+		out[5] = "0123456789abcdef"[c & 0xF];
+		return 6;
+	}
+
+	/* 3 characters of octal is guaranteed not to eat anything following */
+	out[1] = '0' + (c >> 6);
+	out[2] = '0' + (c >> 3 & 7);
+	out[3] = '0' + (c & 7);
+	return 4;
+}
+
+static size_t write_escaped(struct tpf_state *state, enum escape mode, const char *s, size_t len, int dry_run)
+{
+	char seq[8];
+	size_t i, n, total = 0;
+
+	while (len && !(state->error && !dry_run)) {
+		i = scan_special(mode, s, len);
+		if (i && !dry_run)
+			tpf_write(state, i, s);
+		total += i;
+		s     += i;
+		len   -= i;
+
+		if (!len)
+			break;
+
+		n = escape_char(mode, *s, seq);
+		if (!dry_run)
+			tpf_write(state, n, seq);
+		total += n;
+		s++;
+		len--;
+	}
+
+	return total;
+}
+
+/*
+ * The precision limits how much of the argument is read, as for %s, so an
+ * escape sequence is never cut in half. The field width applies to the escaped
+ * output, quotes included.
+ */
+static void convert_escaped(struct tpf_state *state, enum escape mode, const char *s)
+{
+	size_t limit = state->prec_set ? (size_t) state->prec : SIZE_MAX;
+	size_t len = cstrlen(s, limit);
+	int quote = strchr(state->flags, '#') != NULL;
+	int left = strchr(state->flags, '-') != NULL;
+	size_t n;
+
+	if (mode == ESCAPE_CSV) {
+		if (!quote && scan_special(ESCAPE_CSV, s, len) == len) {
+			tpf_pad(state, len);
+			tpf_write(state, len, s);
+			return;
+		}
+		mode = ESCAPE_CSV_QUOTE;
+		quote = 1;
+	}
+
+	if (!left && state->fw_set)
+		tpf_pad(state, write_escaped(state, mode, s, len, 1) + 2 * quote);
+
+	if (quote)
+		tpf_write(state, 1, "\"");
+	n = write_escaped(state, mode, s, len, 0);
+	if (quote)
+		tpf_write(state, 1, "\"");
+
+	if (left)
+		tpf_pad(state, n + 2 * quote);
+}
+
+#ifdef __SIZEOF_INT128__
+typedef __int128          swide;
+typedef unsigned __int128 uwide;
+#else
+typedef intmax_t          swide;
+typedef uintmax_t         uwide;
+#endif
+
+static int read_int(struct tpf_state *state, va_list *ap, swide *v)
 {
 	switch (state->length) {
 	case LENGTH_hh:    *v = (signed char)    va_arg(*ap, signed int);         return 0;
@@ -70,12 +272,15 @@ static int read_int(struct tpf_state *state, va_list *ap, intmax_t *v)
 	case LENGTH_ll:    *v =                  va_arg(*ap, signed long long);   return 0;
 	case LENGTH_j:     *v =                  va_arg(*ap, intmax_t);           return 0;
 	case LENGTH_t:     *v =                  va_arg(*ap, ptrdiff_t);          return 0;
+#ifdef __SIZEOF_INT128__
+	case LENGTH_w128:  *v =                  va_arg(*ap, __int128);           return 0;
+#endif
 	case LENGTH_UNSET: *v =                  va_arg(*ap, signed int);         return 0;
 	default: return -1;
 	}
 }
 
-static int read_unsigned(struct tpf_state *state, va_list *ap, uintmax_t *v)
+static int read_unsigned(struct tpf_state *state, va_list *ap, uwide *v)
 {
 	switch (state->length) {
 	case LENGTH_hh:    *v = (unsigned char)  va_arg(*ap, unsigned int);       return 0;
@@ -84,109 +289,390 @@ static int read_unsigned(struct tpf_state *state, va_list *ap, uintmax_t *v)
 	case LENGTH_ll:    *v =                  va_arg(*ap, unsigned long long); return 0;
 	case LENGTH_j:     *v =                  va_arg(*ap, uintmax_t);          return 0;
 	case LENGTH_z:     *v =                  va_arg(*ap, size_t);             return 0;
+#ifdef __SIZEOF_INT128__
+	case LENGTH_w128:  *v =                  va_arg(*ap, unsigned __int128);  return 0;
+#endif
 	case LENGTH_UNSET: *v =                  va_arg(*ap, unsigned int);       return 0;
 	default: return -1;
 	}
 }
 
-static unsigned digits_unsigned(uintmax_t i, int base)
+static const char pairs[] =
+	"00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839"
+	"40414243444546474849" "50515253545556575859" "60616263646566676869" "70717273747576777879"
+	"80818283848586878889" "90919293949596979899";
+
+static char *put_digits(char *end, uintmax_t v, int min)
 {
-	unsigned l = 0;
-	while (i /= base)
-		l++;
-	return l + 1;
+	/* two digits per division while there are more than two left */
+	while (v >= 100) {
+		unsigned r = v % 100;
+		v /= 100;
+		end -= 2;
+		memcpy(end, pairs + 2 * r, 2);
+		min -= 2;
+	}
+	do {
+		*--end = '0' + v % 10;
+		v /= 10;
+		min--;
+	} while (v || min > 0);
+	return end;
 }
 
-static void convert_int(struct tpf_state *state, uintmax_t i, int sign, int base, const char *alphabet, const char *prefix)
+#ifdef __SIZEOF_INT128__
+/*
+ * Divides *i by 10^9, a 32-bit piece at a time, so that it comes down to
+ * 64-bit divisions by a constant and needs no help from libgcc.
+ */
+static uintmax_t divmod_1e9(uwide *i)
 {
-	int n, digits;
-	int width;
-	int padding = 0;
-	int zero = 0;
+	uint64_t r = 0, cur;
+	uwide q = 0;
+	int shift;
 
-	uintmax_t div;
+	for (shift = 96; shift >= 0; shift -= 32) {
+		cur = r << 32 | (uint32_t)(*i >> shift);
+		q |= (uwide)(cur / 1000000000) << shift;
+		r = cur % 1000000000;
+	}
+
+	*i = q;
+	return r;
+}
+#endif
 
-	char pad = ' ';
-	char pre = '\0';
+/*
+ * Writes the digits of i backwards from end. Values that fit in a uintmax_t
+ * never touch wide arithmetic; decimal ones that don't are cut down 9 digits
+ * at a time (at most three times) until they do.
+ */
+static char *render_unsigned(char *end, uwide i, int base, const char *alphabet)
+{
+	uintmax_t n;
 
-	digits = digits_unsigned(i, base);
-	width = digits + strlen(prefix);
+	if (base == 10) {
+#ifdef __SIZEOF_INT128__
+		while (i > UINTMAX_MAX)
+			end = put_digits(end, divmod_1e9(&i), 9);
+#endif
+		return put_digits(end, (uintmax_t) i, 1);
+	}
 
-	if (!state->prec_set && strchr(state->flags, '0')) pad = '0';
-	if (                    strchr(state->flags, '-')) pad = ' ';
-	if (sign &&             strchr(state->flags, ' ')) pre = ' ';
-	if (sign &&             strchr(state->flags, '+')) pre = '+';
+	/* Otherwise it's a power of two. */
+	if (i > UINTMAX_MAX) {
+		int shift = base == 16 ? 4 : 3;
+		do {
+			*--end = alphabet[(unsigned)(i & (base - 1))];
+			i >>= shift;
+		} while (i > UINTMAX_MAX);
+	}
 
-	if (state->prec_set && digits < state->prec) {
-		width += state->prec - digits;
-		zero   = state->prec - digits;
+	n = i;
+	if (base == 16) {
+		do *--end = alphabet[n & 15]; while (n >>= 4);
+	} else {
+		do *--end = alphabet[n & 7];  while (n >>= 3);
 	}
+	return end;
+}
+
+/* What the flags make of every integer, worked out once per conversion. */
+struct int_style {
+	char pad, pre;
+	int left;
+};
+
+/* Everything that goes around the digits, so they can be streamed or buffered. */
+struct int_layout {
+	char sign;
+	const char *prefix;
+	size_t prefix_len;
+	size_t lpad, zero, rpad;
+	const char *digits;
+	size_t ndigits;
+};
+
+static void int_style(const struct tpf_state *state, struct int_style *style)
+{
+	style->pad = ' ';
+	style->pre = '\0';
+	style->left = strchr(state->flags, '-') != NULL;
 
-	if (state->prec_set && state->prec == 0 && i == 0)
-		width = digits = 0;
+	if (!state->prec_set && strchr(state->flags, '0')) style->pad = '0';
+	if (style->left)                                   style->pad = ' ';
+	if (                    strchr(state->flags, ' ')) style->pre = ' ';
+	if (                    strchr(state->flags, '+')) style->pre = '+';
+}
+
+static void layout_int(const struct tpf_state *state, const struct int_style *style, struct int_layout *l,
+                       char *end, uwide i, int sign, int base, const char *alphabet, const char *prefix)
+{
+	size_t width, padding = 0;
+
+	l->digits = render_unsigned(end, i, base, alphabet);
+	l->ndigits = end - l->digits;
+	l->prefix = prefix;
+	l->prefix_len = strlen(prefix);
+	l->sign = sign < 0 ? '-' : sign ? style->pre : '\0';
+	l->lpad = l->zero = l->rpad = 0;
 
-	if (sign < 0 || pre != '\0')
+	width = l->ndigits + l->prefix_len;
+
+	if (state->prec_set && l->ndigits < state->prec) {
+		width  += state->prec - l->ndigits;
+		l->zero = state->prec - l->ndigits;
+	}
+
+	if (state->prec_set && state->prec == 0 && i == 0) {
+		width -= l->ndigits;
+		l->ndigits = 0;
+	}
+
+	if (l->sign != '\0')
 		width++;
 
 	if (state->fw_set && width < state->fw)
 		padding = state->fw - width;
 
-	if (pad == '0')
-		zero += padding;
+	if (style->pad == '0')
+		l->zero += padding;
+	else if (style->left)
+		l->rpad = padding;
 	else
-		tpf_pad(state, width);
+		l->lpad = padding;
+}
+
+/* All but the trailing padding, which is left to the caller. */
+static void write_int(struct tpf_state *state, const struct int_layout *l)
+{
+	tpf_repeat(state, ' ', l->lpad);
 
-	if (sign < 0)
-		tpf_write(state, 1, "-");
-	else if (pre != '\0')
-		tpf_write(state, 1, &pre);
+	if (l->sign != '\0')
+		tpf_write(state, 1, &l->sign);
+
+	tpf_write(state, l->prefix_len, l->prefix);
+
+	tpf_repeat(state, '0', l->zero);
+
+	if (l->ndigits)
+		tpf_write(state, l->ndigits, l->digits);
+}
 
-	tpf_write(state, strlen(prefix), prefix);
+static char *put_int(char *p, const struct int_layout *l)
+{
+	memset(p, ' ', l->lpad);
+	p += l->lpad;
+	if (l->sign != '\0')
+		*p++ = l->sign;
+	memcpy(p, l->prefix, l->prefix_len);
+	p += l->prefix_len;
+	memset(p, '0', l->zero);
+	p += l->zero;
+	memcpy(p, l->digits, l->ndigits);
+	p += l->ndigits;
+	memset(p, ' ', l->rpad);
+	return p + l->rpad;
+}
 
-	repeat(state, '0', zero);
+static void convert_int(struct tpf_state *state, uwide i, int sign, int base, const char *alphabet, const char *prefix)
+{
+	/* 128 bits of octal is 43 digits */
+	char buf[48];
+	struct int_style style;
+	struct int_layout l;
 
-	div = 1;
-	for (n = 0; n < digits - 1; n++)
-		div *= base;
+	int_style(state, &style);
+	layout_int(state, &style, &l, buf + sizeof buf, i, sign, base, alphabet, prefix);
 
-	for ( ; digits > 0 && div; div /= base)
-		tpf_write(state, 1, alphabet + (i / div) % base);
+	state->padding = l.rpad;
+	write_int(state, &l);
 }
 
-static void convert_signed  (struct tpf_state *state,  intmax_t i, int base, const char *alphabet)
+static void convert_signed  (struct tpf_state *state, swide i, int base, const char *alphabet)
 {
-	uintmax_t x = i < 0 ? -i : i;
-	int sign =    i < 0 ? -1 : 1;
+	uwide x  = i < 0 ? -(uwide) i : (uwide) i;
+	int sign = i < 0 ? -1 : 1;
 
 	convert_int(state, x, sign, base, alphabet, "");
 }
 
-static void convert_unsigned(struct tpf_state *state, uintmax_t i, int base, const char *alphabet, const char *prefix)
+static void convert_unsigned(struct tpf_state *state, uwide i, int base, const char *alphabet, const char *prefix)
 {
 	convert_int(state, i, 0,    base, alphabet, prefix);
 }
 
+static char *put_fraction(char *p, long nsec, size_t prec)
+{
+	static const long scale[] = { 1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1 };
+
+	if (prec == 0)
+		return p;
+
+	*p++ = '.';
+	put_digits(p + prec, nsec / scale[prec], prec);
+	return p + prec;
+}
+
+static int check_timespec(struct tpf_state *state, const struct timespec *ts)
+{
+	if (ts->tv_nsec < 0 || ts->tv_nsec >= 1000000000) {
+		tpf_error(state, "%ld: nanoseconds out of range", (long) ts->tv_nsec);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * The date and time are only rendered from scratch when the minute changes;
+ * within a minute just the seconds digits are patched, and within a second the
+ * cached text is used as is. This means a change to TZ can take up to a minute
+ * to be noticed.
+ */
+struct time_cache {
+	int valid;
+	time_t sec;
+	struct tm tm;
+	char text[48];
+	size_t len;
+};
+
+static int render_time(struct time_cache *c, time_t sec, int utc)
+{
+	if (c->valid && c->sec == sec)
+		return 0;
+
+	if (c->valid && sec > c->sec && sec - c->sec < 60 - c->tm.tm_sec) {
+		c->tm.tm_sec += sec - c->sec;
+		c->text[c->len - 2] = '0' + c->tm.tm_sec / 10;
+		c->text[c->len - 1] = '0' + c->tm.tm_sec % 10;
+		c->sec = sec;
+		return 0;
+	}
+
+	c->valid = 0;
+	if (!(utc ? gmtime_r(&sec, &c->tm) : localtime_r(&sec, &c->tm)))
+		return -1;
+
+	c->len = strftime(c->text, sizeof c->text, utc ? "%Y-%m-%dT%H:%M:%S" : "%Y-%m-%d %H:%M:%S", &c->tm);
+	c->sec = sec;
+	c->valid = c->len > 0;
+	return c->valid ? 0 : -1;
+}
+
+static int convert_time(struct tpf_state *state, const struct timespec *ts)
+{
+#ifdef THREAD_LOCAL
+	static THREAD_LOCAL struct time_cache caches[2];
+#else
+	struct time_cache caches[2] = { { 0 } };
+#endif
+	int utc = strchr(state->flags, '#') != NULL;
+	struct time_cache *c = &caches[utc];
+	size_t prec = state->prec_set ? state->prec : 0;
+	char buf[sizeof c->text + 12], *p = buf;
+
+	if (prec > 9)
+		prec = 9;
+
+	if (render_time(c, ts->tv_sec, utc) != 0) {
+		tpf_error(state, "%lld: seconds out of range for a date", (long long) ts->tv_sec);
+		return -1;
+	}
+
+	memcpy(p, c->text, c->len);
+	p = put_fraction(p + c->len, ts->tv_nsec, prec);
+	if (utc)
+		*p++ = 'Z';
+
+	tpf_pad(state, p - buf);
+	tpf_write(state, p - buf, buf);
+	return 0;
+}
+
+static void convert_duration(struct tpf_state *state, const struct timespec *ts)
+{
+	uintmax_t sec;
+	long nsec = ts->tv_nsec;
+	int neg = ts->tv_sec < 0;
+	size_t prec = state->prec_set ? state->prec : 0;
+	char buf[64], *end = buf + 32, *p;
+
+	if (prec > 9)
+		prec = 9;
+
+	if (!neg) {
+		sec = ts->tv_sec;
+	} else if (nsec == 0) {
+		sec = -(uintmax_t) ts->tv_sec;
+	} else {
+		sec = -(uintmax_t) ts->tv_sec - 1;
+		nsec = 1000000000 - nsec;
+	}
+
+	if (strchr(state->flags, '#')) {
+		p = put_digits(end, sec % 60, 2);
+		*--p = ':';
+		p = put_digits(p, sec / 60 % 60, 2);
+		*--p = ':';
+		p = put_digits(p, sec / 3600, 1);
+	} else {
+		p = put_digits(end, sec, 1);
+	}
+
+	if (neg)
+		*--p = '-';
+	else if (strchr(state->flags, '+'))
+		*--p = '+';
+	else if (strchr(state->flags, ' '))
+		*--p = ' ';
+
+	end = put_fraction(end, nsec, prec);
+
+	tpf_pad(state, end - p);
+	tpf_write(state, end - p, p);
+}
+
+/* What '#' puts in front of v for %o, %x and %X, and their %v forms. */
+static const char *alt_prefix(const struct tpf_state *state, char spec, uwide v)
+{
+	size_t sd = 0;
+	uwide t;
+
+	switch (spec) {
+	case 'x': return v ? "0x" : "";
+	case 'X': return v ? "0X" : "";
+	case 'o':
+		/* The '0' flag still applies, so the extra zero goes in as a prefix. */
+		for (t = v; t; t >>= 3)
+			sd++;
+		return (state->prec_set ? state->prec <= sd : v != 0) ? "0" : "";
+	}
+	return "";
+}
+
 /* here come the converters */
 
-static int conv_pct(struct tpf_state *state, va_list *ap)
+int tprintf__conv_pct(struct tpf_state *state, va_list *ap)
 {
 	tpf_write(state, 1, "%");
 	return 0;
 }
 
-static int conv_c(struct tpf_state *state, va_list *ap)
+int tprintf__conv_c(struct tpf_state *state, va_list *ap)
 {
-	char c[2] = { 0 };
-	wchar_t wc[2] = { 0 };
+	char c;
+	wchar_t wc;
 
 	switch (state->length) {
 	case LENGTH_UNSET:
-		c[0] = (unsigned char) va_arg(*ap, int);
-		convert_cstr(state, c);
+		c = (unsigned char) va_arg(*ap, int);
+		state->prec_set = 0;
+		convert_view(state, 1, &c);
 		return 0;
 	case LENGTH_l:
-		wc[0] = (wchar_t) va_arg(*ap, wint_t);
-		convert_wstr(state, wc);
+		wc = (wchar_t) va_arg(*ap, wint_t);
+		convert_wview(state, 1, &wc);
 		return 0;
 	default:
 		tpf_error(state, "invalid length modifier");
@@ -194,41 +680,33 @@ static int conv_c(struct tpf_state *state, va_list *ap)
 	}
 }
 
-static int conv_i(struct tpf_state *state, va_list *ap)
+int tprintf__conv_i(struct tpf_state *state, va_list *ap)
 {
-	intmax_t v;
+	swide v;
 	if (read_int(state, ap, &v) != 0)
 		return -1;
 	convert_signed(state, v, 10, "0123456789");
 	return 0;
 }
 
-static int conv_n(struct tpf_state *state, va_list *ap)
+int tprintf__conv_n(struct tpf_state *state, va_list *ap)
 {
 	int *p = va_arg(*ap, int *);
 	*p = state->pos;
 	return 0;
 }
 
-static int conv_o(struct tpf_state *state, va_list *ap)
+int tprintf__conv_o(struct tpf_state *state, va_list *ap)
 {
-	uintmax_t v;
+	uwide v;
 	if (read_unsigned(state, ap, &v) != 0)
 		return -1;
 
-	if (strchr(state->flags, '#')) {
-		int sd = v ? digits_unsigned(v, 8) : 0;
-		if (!state->prec_set || sd > state->prec) {
-			state->prec_set = 1;
-			state->prec = sd + 1;
-		}
-	}
-
-	convert_unsigned(state, v, 8, "01234567", "");
+	convert_unsigned(state, v, 8, "01234567", strchr(state->flags, '#') ? alt_prefix(state, 'o', v) : "");
 	return 0;
 }
 
-static int conv_p(struct tpf_state *state, va_list *ap)
+int tprintf__conv_p(struct tpf_state *state, va_list *ap)
 {
 	void *p = va_arg(*ap, void *);
 
@@ -241,7 +719,7 @@ static int conv_p(struct tpf_state *state, va_list *ap)
 	return 0;
 }
 
-static int conv_s(struct tpf_state *state, va_list *ap)
+int tprintf__conv_s(struct tpf_state *state, va_list *ap)
 {
 	const char *c;
 	const wchar_t *wc;
@@ -249,6 +727,8 @@ static int conv_s(struct tpf_state *state, va_list *ap)
 	switch (state->length) {
 	case LENGTH_UNSET:
 		c = va_arg(*ap, const char *);
+		if (!c)
+			c = state->prec_set && state->prec < 6 ? "" : "(null)";
 		convert_cstr(state, c);
 		return 0;
 	case LENGTH_l:
@@ -261,39 +741,267 @@ static int conv_s(struct tpf_state *state, va_list *ap)
 	}
 }
 
-static int conv_u(struct tpf_state *state, va_list *ap)
+int tprintf__conv_V(struct tpf_state *state, va_list *ap)
+{
+	size_t len = va_arg(*ap, size_t);
+
+	switch (state->length) {
+	case LENGTH_UNSET:
+		convert_view(state, len, va_arg(*ap, const char *));
+		return 0;
+	case LENGTH_l:
+		convert_wview(state, len, va_arg(*ap, const wchar_t *));
+		return 0;
+	default:
+		tpf_error(state, "invalid length modifier");
+		return -1;
+	}
+}
+
+int tprintf__conv_J(struct tpf_state *state, va_list *ap)
+{
+	convert_escaped(state, ESCAPE_JSON, va_arg(*ap, const char *));
+	return 0;
+}
+
+int tprintf__conv_Q(struct tpf_state *state, va_list *ap)
+{
+	convert_escaped(state, ESCAPE_CSV,  va_arg(*ap, const char *));
+	return 0;
+}
+
+int tprintf__conv_q(struct tpf_state *state, va_list *ap)
+{
+	convert_escaped(state, ESCAPE_C,    va_arg(*ap, const char *));
+	return 0;
+}
+
+int tprintf__conv_u(struct tpf_state *state, va_list *ap)
 {
-	uintmax_t v;
+	uwide v;
 	if (read_unsigned(state, ap, &v) != 0)
 		return -1;
 	convert_unsigned(state, v, 10, "0123456789", "");
 	return 0;
 }
 
-static int conv_x(struct tpf_state *state, va_list *ap)
+int tprintf__conv_x(struct tpf_state *state, va_list *ap)
 {
-	char *prefix = strchr(state->flags, '#') ? "0x" : "";
-	uintmax_t v;
+	uwide v;
 
 	if (read_unsigned(state, ap, &v) != 0)
 		return -1;
 
-	convert_unsigned(state, v, 16, "0123456789abcdef", prefix);
+	convert_unsigned(state, v, 16, "0123456789abcdef", strchr(state->flags, '#') ? alt_prefix(state, 'x', v) : "");
 	return 0;
 }
 
-static int conv_X(struct tpf_state *state, va_list *ap)
+int tprintf__conv_X(struct tpf_state *state, va_list *ap)
 {
-	char *prefix = strchr(state->flags, '#') ? "0X" : "";
-	uintmax_t v;
+	uwide v;
 
 	if (read_unsigned(state, ap, &v) != 0)
 		return -1;
 
-	convert_unsigned(state, v, 16, "0123456789ABCDEF", prefix);
+	convert_unsigned(state, v, 16, "0123456789ABCDEF", strchr(state->flags, '#') ? alt_prefix(state, 'X', v) : "");
 	return 0;
 }
 
+/*
+ * Element k of an array of the integer type the length modifier names, as a
+ * magnitude and a sign (0 for unsigned).
+ */
+static void read_element(const struct tpf_state *state, int is_signed, const void *v, size_t k, uwide *x, int *sign)
+{
+	swide i;
+
+	if (!is_signed) {
+		*sign = 0;
+		switch (state->length) {
+		case LENGTH_hh:    *x = ((const unsigned char *)      v)[k]; return;
+		case LENGTH_h:     *x = ((const unsigned short *)     v)[k]; return;
+		case LENGTH_l:     *x = ((const unsigned long *)      v)[k]; return;
+		case LENGTH_ll:    *x = ((const unsigned long long *) v)[k]; return;
+		case LENGTH_j:     *x = ((const uintmax_t *)          v)[k]; return;
+		case LENGTH_z:     *x = ((const size_t *)             v)[k]; return;
+#ifdef __SIZEOF_INT128__
+		case LENGTH_w128:  *x = ((const unsigned __int128 *)  v)[k]; return;
+#endif
+		default:           *x = ((const unsigned int *)       v)[k]; return;
+		}
+	}
+
+	switch (state->length) {
+	case LENGTH_hh:    i = ((const signed char *) v)[k]; break;
+	case LENGTH_h:     i = ((const short *)       v)[k]; break;
+	case LENGTH_l:     i = ((const long *)        v)[k]; break;
+	case LENGTH_ll:    i = ((const long long *)   v)[k]; break;
+	case LENGTH_j:     i = ((const intmax_t *)    v)[k]; break;
+	case LENGTH_t:     i = ((const ptrdiff_t *)   v)[k]; break;
+#ifdef __SIZEOF_INT128__
+	case LENGTH_w128:  i = ((const __int128 *)    v)[k]; break;
+#endif
+	default:           i = ((const int *)         v)[k]; break;
+	}
+
+	*x    = i < 0 ? -(uwide) i : (uwide) i;
+	*sign = i < 0 ? -1 : 1;
+}
+
+static int element_length(const struct tpf_state *state, int is_signed)
+{
+	switch (state->length) {
+	case LENGTH_hh: case LENGTH_h: case LENGTH_UNSET:
+	case LENGTH_l:  case LENGTH_ll: case LENGTH_j:
+#ifdef __SIZEOF_INT128__
+	case LENGTH_w128:
+#endif
+		return 0;
+	case LENGTH_t:
+		return is_signed ? 0 : -1;
+	case LENGTH_z:
+		return is_signed ? -1 : 0;
+	default:
+		return -1;
+	}
+}
+
+/* Elements are gathered into a chunk this big before being written. */
+#define ARRAY_CHUNK 4096
+/* Wider elements or separators than this are written one at a time. */
+#define ARRAY_WIDE  256
+
+/*
+ * %vd, %vx, etc: an array of integers, from a size_t count, a pointer to the
+ * first element and a separator (", " if NULL). Each element is converted as
+ * the letter after the 'v' would convert it, with the same flags, width and
+ * precision; the length modifier gives the type of the elements themselves.
+ */
+int tprintf__conv_v(struct tpf_state *state, va_list *ap)
+{
+	size_t n = va_arg(*ap, size_t);
+	const void *v = va_arg(*ap, const void *);
+	const char *sep = va_arg(*ap, const char *);
+	char spec = state->fconv[1];
+	const char *allow = " +-0", *alphabet = "0123456789";
+	int base = 10, is_signed = 0;
+	char chunk[ARRAY_CHUNK], digits[48];
+	char *p = chunk, *end = digits + sizeof digits;
+	struct int_style style;
+	struct int_layout l;
+	size_t seplen, k;
+	const char *f;
+	int buffered, plain, alt;
+
+	switch (spec) {
+	case 'd': case 'i': is_signed = 1;                                        break;
+	case 'u':                                                                 break;
+	case 'o': allow = " +-0#"; base = 8;  alphabet = "01234567";              break;
+	case 'x': allow = " +-0#"; base = 16; alphabet = "0123456789abcdef";      break;
+	case 'X': allow = " +-0#"; base = 16; alphabet = "0123456789ABCDEF";      break;
+	case '\0':
+		tpf_error(state, "missing element conversion for 'v'");
+		return -1;
+	default:
+		tpf_error(state, "'%c': invalid element conversion for 'v'", spec);
+		return -1;
+	}
+
+	for (f = state->flags; *f; f++) {
+		if (!strchr(allow, *f)) {
+			tpf_error(state, "'%c': invalid flag for conversion '%c'", *f, spec);
+			return -1;
+		}
+	}
+
+	if (element_length(state, is_signed) != 0) {
+		tpf_error(state, "invalid length modifier");
+		return -1;
+	}
+
+	state->fconv++;
+
+	if (!sep)
+		sep = ", ";
+	seplen = strlen(sep);
+
+	int_style(state, &style);
+	alt = strchr(state->flags, '#') != NULL;
+	buffered = seplen <= ARRAY_WIDE && (!state->fw_set || state->fw <= ARRAY_WIDE) && (!state->prec_set || state->prec <= ARRAY_WIDE);
+	plain = buffered && base == 10 && !state->fw_set && !state->prec_set && style.pre == '\0';
+
+	for (k = 0; k < n && !state->error; k++) {
+		uwide x;
+		int sign;
+
+		read_element(state, is_signed, v, k, &x, &sign);
+
+		/* The common case: nothing but the digits and maybe a '-'. */
+		if (plain) {
+			char *d = render_unsigned(end, x, 10, alphabet);
+
+			if (sign < 0)
+				*--d = '-';
+			if (chunk + sizeof chunk - p < (ptrdiff_t) (seplen + sizeof digits)) {
+				tpf_write(state, p - chunk, chunk);
+				p = chunk;
+			}
+			if (k) {
+				memcpy(p, sep, seplen);
+				p += seplen;
+			}
+			memcpy(p, d, end - d);
+			p += end - d;
+			continue;
+		}
+
+		layout_int(state, &style, &l, end, x, sign, base, alphabet, alt ? alt_prefix(state, spec, x) : "");
+
+		if (!buffered) {
+			if (k)
+				tpf_write(state, seplen, sep);
+			write_int(state, &l);
+			tpf_repeat(state, ' ', l.rpad);
+			continue;
+		}
+
+		if (chunk + sizeof chunk - p < (ptrdiff_t) (seplen + sizeof digits + 3 * ARRAY_WIDE)) {
+			tpf_write(state, p - chunk, chunk);
+			p = chunk;
+		}
+		if (k) {
+			memcpy(p, sep, seplen);
+			p += seplen;
+		}
+		p = put_int(p, &l);
+	}
+
+	if (p > chunk)
+		tpf_write(state, p - chunk, chunk);
+	return 0;
+}
+
+int tprintf__conv_D(struct tpf_state *state, va_list *ap)
+{
+	const struct timespec *ts = va_arg(*ap, const struct timespec *);
+
+	if (check_timespec(state, ts) != 0)
+		return -1;
+
+	convert_duration(state, ts);
+	return 0;
+}
+
+int tprintf__conv_T(struct tpf_state *state, va_list *ap)
+{
+	const struct timespec *ts = va_arg(*ap, const struct timespec *);
+
+	if (check_timespec(state, ts) != 0)
+		return -1;
+
+	return convert_time(state, ts);
+}
+
 static size_t write_error(void *arg, size_t len, const char *data)
 {
 	return fwrite(data, 1, len, stderr);
@@ -306,15 +1014,22 @@ void tprintf__init(void)
 	tpf_init(tprintf__context);
 	tprintf__context->error = &error_output;
 
-	tpf_register(tprintf__context, '%', "",      conv_pct);
-	tpf_register(tprintf__context, 'c', " +-",   conv_c);
-	tpf_register(tprintf__context, 'd', " +-0",  conv_i);
-	tpf_register(tprintf__context, 'i', " +-0",  conv_i);
-	tpf_register(tprintf__context, 'n', "",      conv_n);
-	tpf_register(tprintf__context, 'o', " +-0#", conv_o);
-	tpf_register(tprintf__context, 'p', " +-",   conv_p);
-	tpf_register(tprintf__context, 's', " +-",   conv_s);
-	tpf_register(tprintf__context, 'u', " +-0",  conv_u);
-	tpf_register(tprintf__context, 'x', " +-0#", conv_x);
-	tpf_register(tprintf__context, 'X', " +-0#", conv_X);
+	tpf_register(tprintf__context, '%', "",      tprintf__conv_pct);
+	tpf_register(tprintf__context, 'c', " +-",   tprintf__conv_c);
+	tpf_register(tprintf__context, 'd', " +-0",  tprintf__conv_i);
+	tpf_register(tprintf__context, 'i', " +-0",  tprintf__conv_i);
+	tpf_register(tprintf__context, 'n', "",      tprintf__conv_n);
+	tpf_register(tprintf__context, 'o', " +-0#", tprintf__conv_o);
+	tpf_register(tprintf__context, 'p', " +-",   tprintf__conv_p);
+	tpf_register(tprintf__context, 's', " +-",   tprintf__conv_s);
+	tpf_register(tprintf__context, 'V', " +-",   tprintf__conv_V);
+	tpf_register(tprintf__context, 'u', " +-0",  tprintf__conv_u);
+	tpf_register(tprintf__context, 'x', " +-0#", tprintf__conv_x);
+	tpf_register(tprintf__context, 'X', " +-0#", tprintf__conv_X);
+	tpf_register(tprintf__context, 'v', " +-0#", tprintf__conv_v);
+	tpf_register(tprintf__context, 'D', " +-#",  tprintf__conv_D);
+	tpf_register(tprintf__context, 'T', "-#",    tprintf__conv_T);
+	tpf_register(tprintf__context, 'J', "-#",    tprintf__conv_J);
+	tpf_register(tprintf__context, 'Q', "-#",    tprintf__conv_Q);
+	tpf_register(tprintf__context, 'q', "-#",    tprintf__conv_q);
 }
@@ -1,2 +1,34 @@
+#ifndef TPRINTF_TSTD_H
+#define TPRINTF_TSTD_H
+
+#include <stdarg.h>
+
+struct tpf_context;
+struct tpf_state;
+
 extern struct tpf_context *tprintf__context;
 void tprintf__init(void);
+
+/*
+ * The converters tprintf__init() registers, for code generated by
+ * tool/specialize.py to call directly.
+ */
+int tprintf__conv_pct(struct tpf_state *, va_list *);
+int tprintf__conv_c  (struct tpf_state *, va_list *);
+int tprintf__conv_i  (struct tpf_state *, va_list *);
+int tprintf__conv_n  (struct tpf_state *, va_list *);
+int tprintf__conv_o  (struct tpf_state *, va_list *);
+int tprintf__conv_p  (struct tpf_state *, va_list *);
+int tprintf__conv_s  (struct tpf_state *, va_list *);
+int tprintf__conv_V  (struct tpf_state *, va_list *);
+int tprintf__conv_J  (struct tpf_state *, va_list *);
+int tprintf__conv_Q  (struct tpf_state *, va_list *);
+int tprintf__conv_q  (struct tpf_state *, va_list *);
+int tprintf__conv_u  (struct tpf_state *, va_list *);
+int tprintf__conv_x  (struct tpf_state *, va_list *);
+int tprintf__conv_X  (struct tpf_state *, va_list *);
+int tprintf__conv_v  (struct tpf_state *, va_list *);
+int tprintf__conv_D  (struct tpf_state *, va_list *);
+int tprintf__conv_T  (struct tpf_state *, va_list *);
+
+#endif
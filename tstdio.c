@@ -2,6 +2,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "tprintf.h"
@@ -15,14 +16,9 @@ static size_t write_FILE(void *arg, size_t len, const char *data)
 	return fwrite(data, 1, len, f);
 }
 
-struct sprintf_context {
-	char *output;
-	size_t pos, limit;
-};
-
 static size_t write_str(void *arg, size_t len, const char *data)
 {
-	struct sprintf_context *context = arg;
+	struct tpf_buffer *context = arg;
 	size_t write = len;
 
 	if (context->limit == 0)
@@ -33,10 +29,121 @@ static size_t write_str(void *arg, size_t len, const char *data)
 
 	memcpy(context->output + context->pos, data, write);
 	context->pos += write;
+	context->output[context->pos] = 0;
+
+	return len;
+}
+
+static size_t write_bounded(void *arg, size_t len, const char *data)
+{
+	struct tpf_buffer *context = arg;
+	size_t room = context->limit ? context->limit - 1 - context->pos : 0;
+
+	if (len > room) {
+		context->full = 1;
+		len = room;
+	}
+
+	if (len) {
+		memcpy(context->output + context->pos, data, len);
+		context->pos += len;
+		context->output[context->pos] = 0;
+	}
+
+	return len;
+}
+
+struct tpf_output tpf_output_FILE(FILE *f)
+{
+	struct tpf_output output = { write_FILE, f };
+	return output;
+}
+
+struct tpf_output tpf_output_buffer(struct tpf_buffer *buffer)
+{
+	struct tpf_output output = { write_str, buffer };
+	return output;
+}
+
+static size_t write_growbuf(void *arg, size_t len, const char *data)
+{
+	struct tpf_growbuf *g = arg;
+
+	if (g->len + len > g->size) {
+		size_t size = g->size ? g->size : 64;
+		char *p;
+
+		while (size < g->len + len)
+			size *= 2;
+
+		p = realloc(g->data, size);
+		if (!p) {
+			g->failed = 1;
+			return 0;
+		}
+		g->data = p;
+		g->size = size;
+	}
+
+	memcpy(g->data + g->len, data, len);
+	g->len += len;
 
 	return len;
 }
 
+static size_t write_tee(void *arg, size_t len, const char *data)
+{
+	struct tpf_tee *tee = arg;
+	return write_growbuf(&tee->stage, len, data);
+}
+
+static void end_tee(void *arg, int result)
+{
+	struct tpf_tee *tee = arg;
+	struct tpf_growbuf *stage = &tee->stage;
+	size_t i;
+
+	for (i = 0; i < tee->nchildren; i++) {
+		struct tpf_tee_child *child = &tee->children[i];
+		const struct tpf_output *out = &child->output;
+
+		if (stage->failed)
+			child->errors++;
+		else if (stage->len && out->writer(out->opaque, stage->len, stage->data) < stage->len)
+			child->errors++;
+		if (out->end)
+			out->end(out->opaque, stage->failed ? -1 : result);
+	}
+
+	stage->len = 0;
+	stage->failed = 0;
+}
+
+struct tpf_output tpf_output_bounded(struct tpf_buffer *buffer)
+{
+	struct tpf_output output = { write_bounded, buffer };
+	return output;
+}
+
+struct tpf_output tpf_output_growbuf(struct tpf_growbuf *g)
+{
+	struct tpf_output output = { write_growbuf, g };
+	return output;
+}
+
+struct tpf_output tpf_output_tee(struct tpf_tee *tee)
+{
+	struct tpf_output output = { write_tee, tee, end_tee };
+	return output;
+}
+
+void tpf_tee_fini(struct tpf_tee *tee)
+{
+	free(tee->stage.data);
+	tee->stage.data = NULL;
+	tee->stage.len = tee->stage.size = 0;
+}
+
 int tprintf_printf(const char *fmt, ...)
 {
 	int r;
@@ -55,7 +162,7 @@ int tprintf_sprintf(char *str, const char *fmt, ...)
 	int r;
 	va_list ap;
 
-	struct sprintf_context context = { str, 0, SIZE_MAX };
+	struct tpf_buffer context = { str, 0, SIZE_MAX };
 	struct tpf_output output = { write_str, &context };
 
 	va_start(ap, fmt);
@@ -72,7 +179,7 @@ int tprintf_snprintf(char *str, size_t n, const char *fmt, ...)
 	int r;
 	va_list ap;
 
-	struct sprintf_context context = { str, 0, n };
+	struct tpf_buffer context = { str, 0, n };
 	struct tpf_output output = { write_str, &context };
 
 	va_start(ap, fmt);
@@ -84,3 +191,24 @@ int tprintf_snprintf(char *str, size_t n, const char *fmt, ...)
 
 	return r;
 }
+
+int tprintf_slprintf(char *str, size_t n, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+
+	struct tpf_buffer context = { str, 0, n };
+	struct tpf_output output = { write_bounded, &context };
+
+	if (n > 0)
+		str[0] = 0;
+
+	va_start(ap, fmt);
+	r = tvprintf(tprintf__context, &output, fmt, ap);
+	va_end(ap);
+
+	if (r >= 0 && context.full)
+		return n;
+
+	return r;
+}
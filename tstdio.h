@@ -1,7 +1,69 @@
+#ifndef TPRINTF_TSTDIO_H
+#define TPRINTF_TSTDIO_H
+
 #include <stddef.h>
+#include <stdio.h>
+
+#include "tprintf.h"
 
 void tprintf__init(void);
 
 int tprintf_printf(const char *, ...);
 int tprintf_sprintf(char *, const char *, ...);
 int tprintf_snprintf(char *, size_t, const char *, ...);
+
+/*
+ * Like snprintf, but formatting stops as soon as the buffer is full, so the
+ * whole length is never worked out. Returns the length written, or the buffer
+ * size if it didn't all fit; %n conversions past that point are not stored.
+ */
+int tprintf_slprintf(char *, size_t, const char *, ...);
+
+/*
+ * A buffer is filled as by snprintf, and kept NUL-terminated. A bounded one
+ * sets full and refuses the rest of the output instead.
+ */
+struct tpf_buffer {
+	char *output;
+	size_t pos, limit;
+	int full;
+};
+
+/*
+ * A buffer that is realloc'd as it fills, and not NUL-terminated. If it can't
+ * grow, failed is set and the rest of the output is refused. The caller frees
+ * data.
+ */
+struct tpf_growbuf {
+	char *data;
+	size_t len, size;
+	int failed;
+};
+
+/*
+ * A tee stages each tvprintf() call and hands the whole of it to every child
+ * once the call ends. A child that fails has its error count bumped; the
+ * others still get the output. If the call couldn't be staged in full, no
+ * child gets any of it and every one of them counts an error. Not safe to
+ * share between threads.
+ */
+struct tpf_tee_child {
+	struct tpf_output output;
+	unsigned long errors;
+};
+
+struct tpf_tee {
+	struct tpf_tee_child *children;
+	size_t nchildren;
+
+	struct tpf_growbuf stage;
+};
+
+struct tpf_output tpf_output_FILE   (FILE *);
+struct tpf_output tpf_output_buffer (struct tpf_buffer *);
+struct tpf_output tpf_output_bounded(struct tpf_buffer *);
+struct tpf_output tpf_output_growbuf(struct tpf_growbuf *);
+struct tpf_output tpf_output_tee    (struct tpf_tee *);
+void              tpf_tee_fini      (struct tpf_tee *);
+
+#endif
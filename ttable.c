@@ -0,0 +1,205 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tprintf.h"
+#include "tstdio.h"
+#include "ttable.h"
+
+struct tpf_row {
+	const struct tpf_context *context;
+	struct tpf_table *table;
+	size_t col;
+	int error;
+
+	/* only set while rendering */
+	struct tpf_state *state;
+	struct tpf_growbuf *scratch;
+};
+
+static size_t write_null(void *arg, size_t len, const char *data)
+{
+	return len;
+}
+
+static const struct tpf_output null_output = { write_null, 0 };
+
+/* Writes the separator, and sets state up for the column's width. */
+static void begin_cell(struct tpf_row *row)
+{
+	struct tpf_state *state = row->state;
+	const struct tpf_column *col = &row->table->columns[row->col];
+	const char *sep = row->table->separator ? row->table->separator : " ";
+
+	if (row->col > 0)
+		tpf_write(state, strlen(sep), sep);
+
+	strcpy(state->flags, col->left ? "-" : "");
+	state->fw = col->width;
+	state->fw_set = 1;
+	state->padding = 0;
+}
+
+static void end_cell(struct tpf_row *row)
+{
+	/* Don't leave trailing whitespace after the last column. */
+	if (row->col + 1 < row->table->ncolumns)
+		tpf_repeat(row->state, ' ', row->state->padding);
+}
+
+static void emit_cell(struct tpf_row *row, size_t len, const char *data)
+{
+	begin_cell(row);
+	tpf_pad(row->state, len);
+	tpf_write(row->state, len, data);
+	end_cell(row);
+}
+
+static size_t write_forward(void *arg, size_t len, const char *data)
+{
+	struct tpf_state *state = arg;
+	size_t pos = state->pos;
+
+	tpf_write(state, len, data);
+	return state->pos - pos;
+}
+
+/*
+ * A right-aligned cell has to be in hand before its padding can be written, so
+ * it goes through scratch. A left-aligned one is padded afterwards, and goes
+ * straight out.
+ */
+static int render_cell(struct tpf_row *row, const char *fmt, va_list ap)
+{
+	struct tpf_output out = tpf_output_growbuf(row->scratch);
+	int r;
+
+	if (row->table->columns[row->col].left) {
+		out.writer = write_forward;
+		out.opaque = row->state;
+
+		begin_cell(row);
+		r = tvprintf(row->context, &out, fmt, ap);
+		if (r < 0)
+			return -1;
+		tpf_pad(row->state, r);
+		end_cell(row);
+		return r;
+	}
+
+	row->scratch->len = 0;
+	r = tvprintf(row->context, &out, fmt, ap);
+	if (r < 0 || row->scratch->failed)
+		return -1;
+
+	emit_cell(row, row->scratch->len, row->scratch->data);
+	return r;
+}
+
+static int vcell(struct tpf_row *row, const char *fmt, va_list ap)
+{
+	struct tpf_column *col;
+	int r;
+
+	if (row->error)
+		return -1;
+
+	if (row->col >= row->table->ncolumns) {
+		row->error = 1;
+		return -1;
+	}
+
+	col = &row->table->columns[row->col];
+	if (!fmt)
+		fmt = col->format;
+
+	if (!row->state) {
+		r = tvprintf(row->context, &null_output, fmt, ap);
+		if (r >= 0 && (size_t) r > col->width)
+			col->width = r;
+	} else {
+		r = render_cell(row, fmt, ap);
+	}
+
+	if (r < 0)
+		row->error = 1;
+	row->col++;
+
+	return r;
+}
+
+int tpf_cell(struct tpf_row *row, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, row);
+	r = vcell(row, 0, ap);
+	va_end(ap);
+	return r;
+}
+
+int tpf_cellf(struct tpf_row *row, const char *fmt, ...)
+{
+	int r;
+	va_list ap;
+	va_start(ap, fmt);
+	r = vcell(row, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+static int do_row(struct tpf_row *row, size_t i)
+{
+	struct tpf_table *table = row->table;
+
+	row->col = 0;
+	if (table->row(row, i, table->opaque) != 0 || row->error)
+		return -1;
+
+	if (!row->state)
+		return 0;
+
+	/* Rows that come up short get empty cells. */
+	for ( ; row->col < table->ncolumns; row->col++)
+		emit_cell(row, 0, "");
+	tpf_write(row->state, 1, "\n");
+
+	return 0;
+}
+
+int tpf_table(const struct tpf_context *context, const struct tpf_output *output, struct tpf_table *table)
+{
+	struct tpf_state state = {.context = context};
+	struct tpf_row row = {.context = context, .table = table};
+	struct tpf_growbuf scratch = { 0 };
+	size_t i;
+	int r = -1;
+
+	state.output = output;
+
+	for (i = 0; i < table->nrows; i++)
+		if (do_row(&row, i) != 0)
+			goto done;
+
+	row.state = &state;
+	row.scratch = &scratch;
+
+	for (i = 0; i < table->nrows; i++)
+		if (do_row(&row, i) != 0)
+			goto done;
+
+	/* As with snprintf, a length that doesn't fit the return value is a failure. */
+	if (state.pos <= INT_MAX)
+		r = state.pos;
+	else
+		errno = EOVERFLOW;
+
+done:
+	free(scratch.data);
+	if (output->end)
+		output->end(output->opaque, r);
+	return r;
+}
@@ -0,0 +1,41 @@
+#ifndef TPRINTF_TTABLE_H
+#define TPRINTF_TTABLE_H
+
+#include <stddef.h>
+
+#include "tprintf.h"
+
+struct tpf_row;
+
+/* width is the least the column may be; tpf_table sets it to what it measured. */
+struct tpf_column {
+	const char *format;
+	int left;
+	size_t width;
+};
+
+/*
+ * row is called once per row in each of two passes, and must supply the same
+ * cells both times: once to measure the columns, once to render them. Both
+ * passes convert every cell in full; measuring only throws the text away. Cells
+ * are given with tpf_cell, using the column's format, or tpf_cellf, which
+ * overrides it (for headers and the like). The whole table is one call as far
+ * as the output's end hook is concerned.
+ *
+ * tpf_table returns the length written, or -1 if a row or cell failed. A table
+ * longer than INT_MAX is still written whole, but fails with errno set to
+ * EOVERFLOW, as snprintf would.
+ */
+struct tpf_table {
+	struct tpf_column *columns;
+	size_t ncolumns, nrows;
+	const char *separator;
+	int (*row)(struct tpf_row *, size_t, void *);
+	void *opaque;
+};
+
+int tpf_table(const struct tpf_context *, const struct tpf_output *, struct tpf_table *);
+int tpf_cell (struct tpf_row *, ...);
+int tpf_cellf(struct tpf_row *, const char *, ...);
+
+#endif